@@ -0,0 +1,86 @@
+/*
+ * SampleCreator
+ *
+ * An experimental idea based on a preliminary convo. Probably best to come back later.
+ *
+ * Copyright Paul Walker 2024
+ *
+ * Released under the MIT License. See `LICENSE.md` for details
+ */
+
+#ifndef SRC_CURVE_HPP
+#define SRC_CURVE_HPP
+
+#include <algorithm>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace baconpaul::samplecreator::curve
+{
+/*
+ * A piecewise linear curve through (x, y) breakpoints, held flat beyond the first and last
+ * points. We use these to scale the gate and tail length across the key range (x is a
+ * midi note) and the velocity layers (x is a velocity). An empty curve is 1 everywhere.
+ */
+struct BreakpointCurve
+{
+    std::vector<std::pair<float, float>> points;
+
+    BreakpointCurve() {}
+    BreakpointCurve(std::vector<std::pair<float, float>> p) : points(std::move(p)) { sort(); }
+
+    void sort() { std::sort(points.begin(), points.end()); }
+
+    float valueAt(float x) const
+    {
+        if (points.empty())
+            return 1.f;
+        if (x <= points.front().first)
+            return points.front().second;
+        if (x >= points.back().first)
+            return points.back().second;
+
+        auto it = std::upper_bound(points.begin(), points.end(), x,
+                                   [](float v, const auto &p) { return v < p.first; });
+        const auto &[x1, y1] = *it;
+        const auto &[x0, y0] = *(it - 1);
+        if (x1 == x0)
+            return y1;
+        return y0 + (y1 - y0) * (x - x0) / (x1 - x0);
+    }
+
+    bool operator==(const BreakpointCurve &o) const { return points == o.points; }
+};
+
+/*
+ * The shapes offered in the menu. Anything else in a patch is kept and shown as custom.
+ */
+struct Preset
+{
+    std::string name;
+    BreakpointCurve curve;
+};
+
+inline const std::vector<Preset> &keyPresets()
+{
+    static const std::vector<Preset> res{
+        {"Flat", {}},
+        {"Shorter Up High", {{{0.f, 1.f}, {60.f, 1.f}, {96.f, 0.5f}, {127.f, 0.25f}}}},
+        {"Much Shorter Up High", {{{0.f, 1.f}, {48.f, 1.f}, {84.f, 0.35f}, {127.f, 0.1f}}}},
+        {"Longer Down Low", {{{0.f, 2.f}, {48.f, 1.f}, {127.f, 1.f}}}},
+    };
+    return res;
+}
+
+inline const std::vector<Preset> &velocityPresets()
+{
+    static const std::vector<Preset> res{
+        {"Flat", {}},
+        {"Shorter When Soft", {{{1.f, 0.5f}, {127.f, 1.f}}}},
+        {"Shorter When Loud", {{{1.f, 1.f}, {127.f, 0.5f}}}},
+    };
+    return res;
+}
+} // namespace baconpaul::samplecreator::curve
+#endif // SAMPLECREATOR_CURVE_HPP
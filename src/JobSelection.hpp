@@ -0,0 +1,249 @@
+/*
+ * SampleCreator
+ *
+ * An experimental idea based on a preliminary convo. Probably best to come back later.
+ *
+ * Copyright Paul Walker 2024
+ *
+ * Released under the MIT License. See `LICENSE.md` for details
+ */
+
+#ifndef SRC_JOBSELECTION_HPP
+#define SRC_JOBSELECTION_HPP
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "RenderJob.hpp"
+
+namespace baconpaul::samplecreator::selection
+{
+/*
+ * A subset of the plan to re-render, leaving the rest of the library on disk alone. A job
+ * is selected if any rule matches it. Rules come from a job list, one per line (or split
+ * with ';'), in one of two forms
+ *
+ *   60 100 1                  note, velocity and round robin, as in the file names. Leave
+ *                             off the round robin, or the velocity too, for all of them.
+ *   note=60-64 vel=100 rr=*   ranges or single values for any of note, vel and rr. A
+ *                             missing key matches everything.
+ *
+ * with '#' starting a comment. Marking a note on the keyboard adds (or removes) a rule
+ * for just that note.
+ */
+struct Range
+{
+    int lo{0}, hi{1 << 16};
+    bool contains(int v) const { return v >= lo && v <= hi; }
+    bool isAll() const { return lo == 0 && hi == (1 << 16); }
+};
+
+struct Rule
+{
+    Range note, vel, rr;
+
+    bool matches(const RenderJob &j) const
+    {
+        return note.contains(j.midiNote) && vel.contains(j.velocity) &&
+               rr.contains(j.roundRobinIndex);
+    }
+    bool isJustNote(int n) const
+    {
+        return note.lo == n && note.hi == n && vel.isAll() && rr.isAll();
+    }
+};
+
+struct JobSelection
+{
+    std::vector<Rule> rules;
+    std::string errMsg;
+
+    bool empty() const { return rules.empty(); }
+
+    bool matches(const RenderJob &j) const
+    {
+        return std::any_of(rules.begin(), rules.end(),
+                           [&j](const auto &r) { return r.matches(j); });
+    }
+
+    bool hasNote(int n) const
+    {
+        return std::any_of(rules.begin(), rules.end(),
+                           [n](const auto &r) { return r.isJustNote(n); });
+    }
+
+    void toggleNote(int n)
+    {
+        auto it = std::remove_if(rules.begin(), rules.end(),
+                                 [n](const auto &r) { return r.isJustNote(n); });
+        if (it != rules.end())
+        {
+            rules.erase(it, rules.end());
+            return;
+        }
+        Rule r;
+        r.note = {n, n};
+        rules.push_back(r);
+    }
+
+    // Replaces the rules, unless the text has an error, when they are left alone
+    bool parse(const std::string &text)
+    {
+        std::vector<Rule> res;
+        std::string line;
+        int lineNo{0};
+        std::istringstream in(text);
+        while (std::getline(in, line))
+        {
+            lineNo++;
+            auto hash = line.find('#');
+            if (hash != std::string::npos)
+                line = line.substr(0, hash);
+
+            std::istringstream ls(line);
+            std::string clause;
+            while (std::getline(ls, clause, ';'))
+            {
+                auto rule = parseRule(clause);
+                if (!errMsg.empty())
+                {
+                    errMsg = "Job list line " + std::to_string(lineNo) + " : " + errMsg;
+                    return false;
+                }
+                if (rule.has_value())
+                    res.push_back(*rule);
+            }
+        }
+        rules = res;
+        return true;
+    }
+
+    std::string toString() const
+    {
+        std::string res;
+        for (const auto &r : rules)
+        {
+            std::string ln;
+            auto add = [&ln](const std::string &k, const Range &rg) {
+                if (rg.isAll())
+                    return;
+                ln += (ln.empty() ? "" : " ") + k + "=" + std::to_string(rg.lo);
+                if (rg.hi != rg.lo)
+                    ln += "-" + std::to_string(rg.hi);
+            };
+            add("note", r.note);
+            add("vel", r.vel);
+            add("rr", r.rr);
+            res += (ln.empty() ? std::string("note=*") : ln) + "\n";
+        }
+        return res;
+    }
+
+  protected:
+    std::optional<Rule> parseRule(const std::string &clause)
+    {
+        errMsg.clear();
+        std::istringstream cs(clause);
+        std::vector<std::string> words;
+        std::string w;
+        while (cs >> w)
+            words.push_back(w);
+        if (words.empty())
+            return std::nullopt;
+
+        Rule res;
+        if (words[0].find('=') == std::string::npos)
+        {
+            if (words.size() > 3)
+            {
+                errMsg = "expected note, velocity and round robin";
+                return std::nullopt;
+            }
+            Range *into[3]{&res.note, &res.vel, &res.rr};
+            int maxes[3]{maxNote, maxVelocity, maxRoundRobin};
+            for (size_t i = 0; i < words.size(); ++i)
+                if (!parseRange(words[i], *into[i], maxes[i]))
+                    return std::nullopt;
+            return res;
+        }
+
+        for (const auto &kv : words)
+        {
+            auto eq = kv.find('=');
+            if (eq == std::string::npos)
+            {
+                errMsg = "expected key=value, not '" + kv + "'";
+                return std::nullopt;
+            }
+            auto k = kv.substr(0, eq);
+            Range *into{nullptr};
+            int maxV{0};
+            if (k == "note")
+            {
+                into = &res.note;
+                maxV = maxNote;
+            }
+            else if (k == "vel")
+            {
+                into = &res.vel;
+                maxV = maxVelocity;
+            }
+            else if (k == "rr")
+            {
+                into = &res.rr;
+                maxV = maxRoundRobin;
+            }
+            if (!into)
+            {
+                errMsg = "unknown key '" + k + "'";
+                return std::nullopt;
+            }
+            if (!parseRange(kv.substr(eq + 1), *into, maxV))
+                return std::nullopt;
+        }
+        return res;
+    }
+
+    static constexpr int maxNote{127}, maxVelocity{127}, maxRoundRobin{255};
+
+    // "*", "N" or "N-M", with N and M no more than maxV
+    bool parseRange(const std::string &s, Range &onto, int maxV)
+    {
+        if (s == "*")
+        {
+            onto = Range();
+            return true;
+        }
+        auto isNum = [](const std::string &v) {
+            return !v.empty() && std::all_of(v.begin(), v.end(),
+                                             [](auto c) { return std::isdigit((unsigned char)c); });
+        };
+        auto dash = s.find('-');
+        auto a = s.substr(0, dash);
+        auto b = dash == std::string::npos ? a : s.substr(dash + 1);
+        if (!isNum(a) || !isNum(b))
+        {
+            errMsg = "expected a number or range, not '" + s + "'";
+            return false;
+        }
+        auto la = std::strtol(a.c_str(), nullptr, 10);
+        auto lb = std::strtol(b.c_str(), nullptr, 10);
+        if (la > maxV || lb > maxV)
+        {
+            errMsg = "'" + s + "' is out of range; the most is " + std::to_string(maxV);
+            return false;
+        }
+        onto.lo = (int)la;
+        onto.hi = (int)lb;
+        if (onto.hi < onto.lo)
+            std::swap(onto.lo, onto.hi);
+        return true;
+    }
+};
+} // namespace baconpaul::samplecreator::selection
+#endif // SAMPLECREATOR_JOBSELECTION_HPP
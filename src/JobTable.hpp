@@ -0,0 +1,156 @@
+/*
+ * SampleCreator
+ *
+ * An experimental idea based on a preliminary convo. Probably best to come back later.
+ *
+ * Copyright Paul Walker 2024
+ *
+ * Released under the MIT License. See `LICENSE.md` for details
+ */
+
+#ifndef SRC_JOBTABLE_HPP
+#define SRC_JOBTABLE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <vector>
+
+#include "RenderJob.hpp"
+
+namespace baconpaul::samplecreator
+{
+/*
+ * The render plan, stored a column per field. Notes and velocities are midi so fit a
+ * byte, the round robin voltages sit together in one array, and clear() keeps the
+ * capacity so rebuilding a plan of 100k jobs into the same table doesn't allocate. Code
+ * which wants one field reads its column; anything wanting a whole job gets a RenderJob
+ * back by value from [] or the iterator.
+ */
+struct JobTable
+{
+    std::vector<int8_t> midiNote, noteFrom, noteTo;
+    std::vector<int8_t> velocity, velFrom, velTo;
+    std::vector<uint8_t> roundRobinIndex, roundRobinOutOf;
+    std::vector<float> rrRand; // RenderJob::nRRVoltages per job
+    std::vector<float> gateSeconds, maxTailSeconds;
+
+    size_t size() const { return midiNote.size(); }
+    bool empty() const { return midiNote.empty(); }
+
+    // every column with one entry per job, which is all but rrRand
+    template <typename F> void forEachJobColumn(F f)
+    {
+        f(midiNote);
+        f(noteFrom);
+        f(noteTo);
+        f(velocity);
+        f(velFrom);
+        f(velTo);
+        f(roundRobinIndex);
+        f(roundRobinOutOf);
+        f(gateSeconds);
+        f(maxTailSeconds);
+    }
+
+    void clear()
+    {
+        forEachJobColumn([](auto &c) { c.clear(); });
+        rrRand.clear();
+    }
+
+    void reserve(size_t n)
+    {
+        forEachJobColumn([n](auto &c) { c.reserve(n); });
+        rrRand.reserve(n * RenderJob::nRRVoltages);
+    }
+
+    void push_back(const RenderJob &j)
+    {
+        midiNote.push_back((int8_t)j.midiNote);
+        noteFrom.push_back((int8_t)j.noteFrom);
+        noteTo.push_back((int8_t)j.noteTo);
+        velocity.push_back((int8_t)j.velocity);
+        velFrom.push_back((int8_t)j.velFrom);
+        velTo.push_back((int8_t)j.velTo);
+        roundRobinIndex.push_back((uint8_t)j.roundRobinIndex);
+        roundRobinOutOf.push_back((uint8_t)j.roundRobinOutOf);
+        for (auto r : j.rrRand)
+            rrRand.push_back(r);
+        gateSeconds.push_back(j.gateSeconds);
+        maxTailSeconds.push_back(j.maxTailSeconds);
+    }
+
+    RenderJob operator[](size_t i) const
+    {
+        RenderJob j;
+        j.midiNote = midiNote[i];
+        j.noteFrom = noteFrom[i];
+        j.noteTo = noteTo[i];
+        j.velocity = velocity[i];
+        j.velFrom = velFrom[i];
+        j.velTo = velTo[i];
+        j.roundRobinIndex = roundRobinIndex[i];
+        j.roundRobinOutOf = roundRobinOutOf[i];
+        for (int d = 0; d < RenderJob::nRRVoltages; ++d)
+            j.rrRand[d] = rrRand[i * RenderJob::nRRVoltages + d];
+        j.gateSeconds = gateSeconds[i];
+        j.maxTailSeconds = maxTailSeconds[i];
+        return j;
+    }
+
+    // Keep only the jobs for which keep(job) is true, in order
+    template <typename F> void retainIf(F keep)
+    {
+        size_t w{0};
+        for (size_t r = 0; r < size(); ++r)
+        {
+            if (!keep((*this)[r]))
+                continue;
+            if (w != r)
+            {
+                forEachJobColumn([w, r](auto &c) { c[w] = c[r]; });
+                for (int d = 0; d < RenderJob::nRRVoltages; ++d)
+                    rrRand[w * RenderJob::nRRVoltages + d] = rrRand[r * RenderJob::nRRVoltages + d];
+            }
+            w++;
+        }
+        forEachJobColumn([w](auto &c) { c.resize(w); });
+        rrRand.resize(w * RenderJob::nRRVoltages);
+    }
+
+    bool operator==(const JobTable &o) const
+    {
+        return midiNote == o.midiNote && noteFrom == o.noteFrom && noteTo == o.noteTo &&
+               velocity == o.velocity && velFrom == o.velFrom && velTo == o.velTo &&
+               roundRobinIndex == o.roundRobinIndex && roundRobinOutOf == o.roundRobinOutOf &&
+               rrRand == o.rrRand && gateSeconds == o.gateSeconds &&
+               maxTailSeconds == o.maxTailSeconds;
+    }
+    bool operator!=(const JobTable &o) const { return !(*this == o); }
+
+    struct const_iterator
+    {
+        using iterator_category = std::input_iterator_tag;
+        using value_type = RenderJob;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = RenderJob;
+
+        const JobTable *table{nullptr};
+        size_t index{0};
+
+        RenderJob operator*() const { return (*table)[index]; }
+        const_iterator &operator++()
+        {
+            ++index;
+            return *this;
+        }
+        bool operator==(const const_iterator &o) const { return index == o.index; }
+        bool operator!=(const const_iterator &o) const { return index != o.index; }
+    };
+    const_iterator begin() const { return {this, 0}; }
+    const_iterator end() const { return {this, size()}; }
+};
+} // namespace baconpaul::samplecreator
+#endif // SAMPLECREATOR_JOBTABLE_HPP
@@ -0,0 +1,297 @@
+/*
+ * SampleCreator
+ *
+ * An experimental idea based on a preliminary convo. Probably best to come back later.
+ *
+ * Copyright Paul Walker 2024
+ *
+ * Released under the MIT License. See `LICENSE.md` for details
+ */
+
+#ifndef SRC_MANIFEST_HPP
+#define SRC_MANIFEST_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "RenderJob.hpp"
+
+namespace baconpaul::samplecreator::manifest
+{
+/*
+ * A binary manifest written next to each render with one fixed size record per take.
+ * Downstream consumers (rewrap, dedupe, the UI) read this rather than opening and scanning
+ * every wav. Records are fixed size so a reader can go straight to record i without
+ * loading the rest, which keeps opening a 100k take library instant.
+ *
+ * All values are little endian, as are the wavs.
+ */
+static constexpr char fileName[] = "SampleCreatorManifest.bin";
+// sharded renders each write their own, as SampleCreatorManifest.<shard>.bin
+static constexpr char fileStem[] = "SampleCreatorManifest";
+static constexpr char fileExtension[] = ".bin";
+
+inline bool isManifestFileName(const std::string &fn)
+{
+    std::string stem{fileStem}, ext{fileExtension};
+    return fn.size() >= stem.size() + ext.size() && fn.compare(0, stem.size(), stem) == 0 &&
+           fn.compare(fn.size() - ext.size(), ext.size(), ext) == 0;
+}
+static constexpr uint32_t currentVersion{2};
+
+struct Header
+{
+    char magic[4]{'S', 'C', 'M', 'F'};
+    uint32_t version{currentVersion};
+    uint32_t recordSize{0};
+    uint32_t reserved{0};
+};
+
+// TakeRecord::flags
+enum TakeFlags : uint16_t
+{
+    TAKE_ENGINE_OVERLOAD = 1 << 0,   // the engine fell behind real time during the take
+    TAKE_TRANSPORT_OVERRUN = 1 << 1, // audio was overwritten before the writer saw it
+    TAKE_REQUEUED = 1 << 2,          // to be recorded again as the render ends
+    TAKE_RERECORDED = 1 << 3,        // a second or later attempt at the take
+};
+
+struct TakeRecord
+{
+    int16_t midiNote{0}, noteFrom{0}, noteTo{0};
+    int16_t velocity{0}, velFrom{0}, velTo{0};
+    int16_t roundRobinIndex{0}, roundRobinOutOf{1};
+    float rrRand[2]{0.f, 0.f};
+
+    uint32_t sampleRate{0};
+    uint16_t nChannels{0};
+    uint16_t flags{0};
+
+    uint64_t frameCount{0};
+    uint64_t tailFrames{0}; // frames recorded after the gate was released
+    float peak{0.f}, rms{0.f};
+    uint64_t hash{0};       // of the sample data, for dedupe and change detection
+    uint64_t dataOffset{0}; // byte offset of the sample data in the wav
+
+    char path[128]{}; // relative to the wav (or raw) directory, zero terminated
+
+    // from version 2; zero in records read from a version 1 manifest
+    uint64_t fingerprint{0}; // of the job and render settings, see RenderJob.hpp
+    uint64_t writtenAt{0};   // microseconds since the epoch, so a merge keeps the latest
+
+    RenderJob toJob() const
+    {
+        RenderJob j;
+        j.midiNote = midiNote;
+        j.noteFrom = noteFrom;
+        j.noteTo = noteTo;
+        j.velocity = velocity;
+        j.velFrom = velFrom;
+        j.velTo = velTo;
+        j.roundRobinIndex = roundRobinIndex;
+        j.roundRobinOutOf = roundRobinOutOf;
+        j.rrRand[0] = rrRand[0];
+        j.rrRand[1] = rrRand[1];
+        return j;
+    }
+
+    void fromJob(const RenderJob &j)
+    {
+        midiNote = j.midiNote;
+        noteFrom = j.noteFrom;
+        noteTo = j.noteTo;
+        velocity = j.velocity;
+        velFrom = j.velFrom;
+        velTo = j.velTo;
+        roundRobinIndex = j.roundRobinIndex;
+        roundRobinOutOf = j.roundRobinOutOf;
+        rrRand[0] = j.rrRand[0];
+        rrRand[1] = j.rrRand[1];
+    }
+
+    Take toTake() const { return {toJob(), fs::path{std::string(path)}, frameCount}; }
+};
+static_assert(sizeof(TakeRecord) == 216, "Manifest records are a fixed on-disk size");
+static constexpr uint32_t version1RecordSize{200};
+
+inline uint64_t nowMicroseconds()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+               std::chrono::system_clock::now().time_since_epoch())
+        .count();
+}
+
+/*
+ * Accumulates the per take metrics as sample blocks go past on the render thread
+ */
+struct TakeMetrics
+{
+    uint64_t frames{0};
+    double sumSquares{0};
+    float peak{0};
+    uint64_t hash{14695981039346656037ULL};
+
+    void reset() { *this = TakeMetrics(); }
+
+    void accumulate(const float *d, size_t nSamples, int nChannels)
+    {
+        for (size_t i = 0; i < nSamples; ++i)
+        {
+            auto f = std::fabs(d[i]);
+            peak = std::max(peak, f);
+            sumSquares += d[i] * d[i];
+
+            // FNV-1a over the 32 bit words
+            uint32_t w;
+            memcpy(&w, d + i, sizeof(w));
+            hash = (hash ^ w) * 1099511628211ULL;
+        }
+        frames += nSamples / std::max(nChannels, 1);
+    }
+
+    float rms(int nChannels) const
+    {
+        auto n = frames * std::max(nChannels, 1);
+        return n ? std::sqrt(sumSquares / n) : 0.f;
+    }
+};
+
+struct ManifestWriter
+{
+    fs::path outPath{};
+    FILE *outf{nullptr};
+    std::string errMsg{};
+
+    ~ManifestWriter() { closeFile(); }
+
+    [[nodiscard]] bool openFile(const fs::path &p)
+    {
+        closeFile();
+        outPath = p;
+        outf = fopen(outPath.u8string().c_str(), "wb");
+        if (!outf)
+        {
+            errMsg = "Unable to open '" + outPath.u8string() + "' for writing";
+            return false;
+        }
+        Header h;
+        h.recordSize = sizeof(TakeRecord);
+        std::fwrite(&h, sizeof(h), 1, outf);
+        std::fflush(outf);
+        return true;
+    }
+
+    // Flushed on each take so a stopped or crashed render still leaves a usable manifest
+    void push(const TakeRecord &r)
+    {
+        if (!outf)
+            return;
+        std::fwrite(&r, sizeof(r), 1, outf);
+        std::fflush(outf);
+    }
+
+    bool isOpen() { return outf != nullptr; }
+    void closeFile()
+    {
+        if (outf)
+        {
+            std::fclose(outf);
+            outf = nullptr;
+        }
+    }
+};
+
+/*
+ * Lazy reader. Opening reads only the header; records are read on demand.
+ */
+struct ManifestReader
+{
+    fs::path inPath{};
+    FILE *inf{nullptr};
+    Header header;
+    size_t count{0};
+    std::string errMsg{};
+
+    ManifestReader() {}
+    ManifestReader(const fs::path &p) : inPath(p) {}
+    ~ManifestReader() { closeFile(); }
+
+    ManifestReader(const ManifestReader &) = delete;
+    ManifestReader &operator=(const ManifestReader &) = delete;
+
+    [[nodiscard]] bool openFile()
+    {
+        closeFile();
+        inf = fopen(inPath.u8string().c_str(), "rb");
+        if (!inf)
+        {
+            errMsg = "Unable to open '" + inPath.u8string() + "' for reading";
+            return false;
+        }
+        if (std::fread(&header, sizeof(header), 1, inf) != 1 ||
+            memcmp(header.magic, "SCMF", 4) != 0 || header.recordSize < version1RecordSize)
+        {
+            errMsg = "'" + inPath.filename().u8string() + "' is not a SampleCreator manifest";
+            closeFile();
+            return false;
+        }
+
+        // records from a newer version may be longer and we read the prefix we understand;
+        // those from an older one are shorter and leave the newer fields at their defaults
+        std::fseek(inf, 0, SEEK_END);
+        auto sz = (size_t)std::ftell(inf);
+        count = (sz - sizeof(Header)) / header.recordSize;
+        return true;
+    }
+
+    bool isOpen() { return inf != nullptr; }
+    void closeFile()
+    {
+        if (inf)
+        {
+            std::fclose(inf);
+            inf = nullptr;
+        }
+        count = 0;
+    }
+
+    size_t size() const { return count; }
+
+    bool get(size_t i, TakeRecord &r)
+    {
+        if (!inf || i >= count)
+            return false;
+        if (std::fseek(inf, sizeof(Header) + i * header.recordSize, SEEK_SET))
+            return false;
+        r = TakeRecord();
+        auto n = std::min((size_t)header.recordSize, sizeof(TakeRecord));
+        return std::fread(&r, n, 1, inf) == 1;
+    }
+
+    std::vector<TakeRecord> readAll()
+    {
+        std::vector<TakeRecord> res;
+        if (!inf)
+            return res;
+        if (header.recordSize == sizeof(TakeRecord))
+        {
+            res.resize(count);
+            std::fseek(inf, sizeof(Header), SEEK_SET);
+            res.resize(std::fread(res.data(), sizeof(TakeRecord), count, inf));
+            return res;
+        }
+        res.reserve(count);
+        TakeRecord r;
+        for (size_t i = 0; i < count; ++i)
+            if (get(i, r))
+                res.push_back(r);
+        return res;
+    }
+};
+} // namespace baconpaul::samplecreator::manifest
+#endif // SAMPLECREATOR_MANIFEST_HPP
@@ -0,0 +1,206 @@
+/*
+ * SampleCreator
+ *
+ * An experimental idea based on a preliminary convo. Probably best to come back later.
+ *
+ * Copyright Paul Walker 2024
+ *
+ * Released under the MIT License. See `LICENSE.md` for details
+ */
+
+#ifndef SRC_MULTIFILEWRITER_HPP
+#define SRC_MULTIFILEWRITER_HPP
+
+#include <algorithm>
+#include <fstream>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "RenderJob.hpp"
+
+namespace baconpaul::samplecreator::multifile
+{
+/*
+ * The multi-files (SFZ, Decent, MultiSample) are written in one go from the list of
+ * finished takes. Takes can finish in any order so we sort them here into velocity
+ * layer, then round robin, then key order. That lets the SFZ and Decent writers emit one
+ * group per layer and round robin and hoist the opcodes which are shared, rather than
+ * repeating lovel / hivel / seq_length on each of the (potentially 16k) regions.
+ */
+inline std::vector<Take> sortedByLayer(std::vector<Take> takes)
+{
+    std::sort(takes.begin(), takes.end(), [](const auto &a, const auto &b) {
+        const auto &ja = a.job;
+        const auto &jb = b.job;
+        return std::tie(ja.velFrom, ja.velTo, ja.roundRobinOutOf, ja.roundRobinIndex, ja.noteFrom,
+                        ja.midiNote) < std::tie(jb.velFrom, jb.velTo, jb.roundRobinOutOf,
+                                                jb.roundRobinIndex, jb.noteFrom, jb.midiNote);
+    });
+    return takes;
+}
+
+inline bool sameLayer(const RenderJob &a, const RenderJob &b)
+{
+    return a.velFrom == b.velFrom && a.velTo == b.velTo;
+}
+
+inline bool sameRoundRobin(const RenderJob &a, const RenderJob &b)
+{
+    return a.roundRobinIndex == b.roundRobinIndex && a.roundRobinOutOf == b.roundRobinOutOf;
+}
+
+// The round robin length if every take agrees on it, or -1 if it varies
+inline int commonRoundRobinLength(const std::vector<Take> &takes)
+{
+    if (takes.empty())
+        return 1;
+    auto res = takes[0].job.roundRobinOutOf;
+    for (const auto &t : takes)
+        if (t.job.roundRobinOutOf != res)
+            return -1;
+    return res;
+}
+
+inline std::string pathString(const Take &t) { return t.relativePath.generic_u8string(); }
+
+inline bool writeSFZ(const fs::path &outFile, const std::string &defaultPath,
+                     const std::vector<Take> &inTakes)
+{
+    std::ofstream of(outFile);
+    if (!of.is_open())
+        return false;
+
+    auto takes = sortedByLayer(inTakes);
+    auto seqLength = commonRoundRobinLength(takes);
+
+    of << "// Basic SFZ File from Rack Sample Creator\n\n";
+    of << "<control>\ndefault_path=" << defaultPath << "\n\n";
+    of << "<global>";
+    if (seqLength > 1)
+        of << " seq_length=" << seqLength;
+    of << "\n";
+
+    const RenderJob *prior{nullptr};
+    for (const auto &t : takes)
+    {
+        const auto &j = t.job;
+        if (!prior || !sameLayer(*prior, j))
+        {
+            of << "\n<master> lovel=" << j.velFrom << " hivel=" << j.velTo << "\n";
+            prior = nullptr;
+        }
+        if (!prior || !sameRoundRobin(*prior, j))
+        {
+            of << "<group>";
+            if (seqLength < 0 && j.roundRobinOutOf > 1)
+                of << " seq_length=" << j.roundRobinOutOf;
+            if (j.roundRobinOutOf > 1)
+                of << " seq_position=" << (j.roundRobinIndex + 1);
+            of << "\n";
+        }
+
+        of << "<region> sample=" << pathString(t);
+        if (j.noteFrom == j.noteTo && j.noteFrom == j.midiNote)
+            of << " key=" << j.midiNote;
+        else
+            of << " lokey=" << j.noteFrom << " hikey=" << j.noteTo
+               << " pitch_keycenter=" << j.midiNote;
+        of << "\n";
+        prior = &j;
+    }
+
+    of.close();
+    return !of.fail();
+}
+
+inline bool writeDecent(const fs::path &outFile, const std::string &defaultPath,
+                        const std::vector<Take> &inTakes)
+{
+    std::ofstream of(outFile);
+    if (!of.is_open())
+        return false;
+
+    auto takes = sortedByLayer(inTakes);
+    auto seqLength = commonRoundRobinLength(takes);
+
+    of << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n";
+    of << "<DecentSampler minVersion=\"1.0.0\">\n";
+    of << "  <groups";
+    if (seqLength > 1)
+        of << " seqMode=\"round_robin\" seqLength=\"" << seqLength << "\"";
+    of << ">\n";
+
+    const RenderJob *prior{nullptr};
+    for (const auto &t : takes)
+    {
+        const auto &j = t.job;
+        if (!prior || !sameLayer(*prior, j) || !sameRoundRobin(*prior, j))
+        {
+            if (prior)
+                of << "    </group>\n";
+            of << "    <group loVel=\"" << j.velFrom << "\" hiVel=\"" << j.velTo << "\"";
+            if (seqLength < 0 && j.roundRobinOutOf > 1)
+                of << " seqMode=\"round_robin\" seqLength=\"" << j.roundRobinOutOf << "\"";
+            if (j.roundRobinOutOf > 1)
+                of << " seqPosition=\"" << (j.roundRobinIndex + 1) << "\"";
+            of << ">\n";
+        }
+
+        of << "      <sample path=\"" << defaultPath << pathString(t) << "\" "
+           << "rootNote=\"" << j.midiNote << "\" "
+           << "loNote=\"" << j.noteFrom << "\" "
+           << "hiNote=\"" << j.noteTo << "\"/>\n";
+        prior = &j;
+    }
+    if (prior)
+        of << "    </group>\n";
+
+    of << "  </groups>\n";
+    of << "</DecentSampler>\n";
+
+    of.close();
+    return !of.fail();
+}
+
+/*
+ * The bitwig / presonus multisample format has no grouping so is written a sample at a
+ * time in the order given, which is the order the module rendered them
+ */
+inline bool writeMultiSample(const fs::path &outFile, const std::string &name,
+                             const std::vector<Take> &takes)
+{
+    std::ofstream of(outFile);
+    if (!of.is_open())
+        return false;
+
+    of << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n";
+    of << "<multisample name=\"" << name << "\">\n";
+
+    for (const auto &t : takes)
+    {
+        const auto &j = t.job;
+        of << "    <sample file=\"" << pathString(t) << "\" ";
+        if (j.roundRobinOutOf > 1)
+            of << " zone-logic=\"round-robin\" ";
+        of << " sample-start=\"0\" sample-stop=\"" << t.sampleCount << "\" ";
+        of << ">\n";
+
+        of << "         <key "
+           << "low=\"" << j.noteFrom << "\" "
+           << "high=\"" << j.noteTo << "\" "
+           << "root=\"" << j.midiNote << "\" "
+           << "/>\n";
+        of << "         <velocity "
+           << "low=\"" << j.velFrom << "\" "
+           << "high=\"" << j.velTo << "\"/>\n";
+
+        of << "    </sample>\n";
+    }
+    of << "</multisample>\n";
+
+    of.close();
+    return !of.fail();
+}
+} // namespace baconpaul::samplecreator::multifile
+#endif // SAMPLECREATOR_MULTIFILEWRITER_HPP
@@ -0,0 +1,100 @@
+/*
+ * SampleCreator
+ *
+ * An experimental idea based on a preliminary convo. Probably best to come back later.
+ *
+ * Copyright Paul Walker 2024
+ *
+ * Released under the MIT License. See `LICENSE.md` for details
+ */
+
+#ifndef SRC_OVERLOADMONITOR_HPP
+#define SRC_OVERLOADMONITOR_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+
+namespace baconpaul::samplecreator::overload
+{
+/*
+ * Spotting takes recorded while the engine fell behind. Rack runs the engine a block at a
+ * time, paced by the audio device, so the wall clock less the frames we have processed
+ * (the lag) swings by about a block while all is well. When the engine can't keep up the
+ * device drops out and the time is never made back, so the lag steps up and stays there;
+ * a patch with audio coming in from outside the engine has a glitch at that point.
+ *
+ * So we measure the lag every checkInterval frames and keep its floor over windows longer
+ * than any block. Each take remembers the floor as it started and the most any later
+ * window rose above it; more than slackSeconds and the take is suspect.
+ */
+struct LagClock
+{
+    static constexpr uint32_t checkInterval{64};
+    static constexpr double windowSeconds{0.25};
+
+    using clock_t = std::chrono::steady_clock;
+    clock_t::time_point start;
+    double sampleRate{48000};
+    uint64_t frames{0};
+    uint32_t checksPerWindow{1}, checksInWindow{0};
+    double windowFloor{0};
+
+    void reset(double sr)
+    {
+        start = clock_t::now();
+        sampleRate = sr;
+        frames = 0;
+        checksPerWindow = std::max(1U, (uint32_t)(windowSeconds * sr / checkInterval));
+        checksInWindow = 0;
+    }
+
+    // Once a frame. True when a window has just finished, with its floor in windowFloor
+    bool step()
+    {
+        if (frames++ % checkInterval != 0)
+            return false;
+        auto wall = std::chrono::duration<double>(clock_t::now() - start).count();
+        auto lag = wall - frames / sampleRate;
+        windowFloor = checksInWindow == 0 ? lag : std::min(windowFloor, lag);
+        if (++checksInWindow < checksPerWindow)
+            return false;
+        checksInWindow = 0;
+        return true;
+    }
+
+    // The floor of the window in progress, if it is long enough to have seen a block end
+    bool partialFloor(double &floor) const
+    {
+        if (checksInWindow < checksPerWindow / 2)
+            return false;
+        floor = windowFloor;
+        return true;
+    }
+};
+
+struct TakeTiming
+{
+    static constexpr double slackSeconds{0.02};
+
+    bool hasBase{false};
+    double baseFloor{0}, drift{0};
+    uint32_t overruns{0};
+
+    void reset() { *this = TakeTiming(); }
+
+    void windowDone(double floor)
+    {
+        if (!hasBase)
+        {
+            hasBase = true;
+            baseFloor = floor;
+            return;
+        }
+        drift = std::max(drift, floor - baseFloor);
+    }
+
+    bool overloaded() const { return drift > slackSeconds; }
+};
+} // namespace baconpaul::samplecreator::overload
+#endif // SAMPLECREATOR_OVERLOADMONITOR_HPP
@@ -0,0 +1,116 @@
+/*
+ * SampleCreator
+ *
+ * An experimental idea based on a preliminary convo. Probably best to come back later.
+ *
+ * Copyright Paul Walker 2024
+ *
+ * Released under the MIT License. See `LICENSE.md` for details
+ */
+
+#ifndef SRC_PLANESTIMATOR_HPP
+#define SRC_PLANESTIMATOR_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "JobTable.hpp"
+
+namespace baconpaul::samplecreator::estimate
+{
+/*
+ * Predicts how long a render will take and how much disk it will use, without running
+ * it. Each job records its gate plus a tail (the expected tail, capped by the job's
+ * maximum), and costs that plus the latency and spindown in wall clock. Voices then
+ * divide the wall clock: in lockstep each batch takes as long as its longest job, and
+ * overlapped the busy voices share the total.
+ *
+ * It can only be as good as expectedTailSeconds, which is a guess until a render has run.
+ */
+struct EstimateSettings
+{
+    int sampleRate{48000};
+    int nChannels{2};
+    int nVoices{1};
+    bool lockstep{true};
+    float latencySeconds{0.f};
+    float expectedTailSeconds{2.f};
+    float spindownSeconds{0.02f};
+
+    // the multi-file's own copy of the sample data, per sample per channel
+    float extraBytesPerSample{0.f};
+    bool extraFirstRROnly{false};
+};
+
+struct PlanEstimate
+{
+    size_t jobs{0};
+    double seconds{0};
+    double bytes{0};
+};
+
+inline double tailSeconds(const RenderJob &j, const EstimateSettings &s)
+{
+    return j.maxTailSeconds > 0 ? std::min((double)j.maxTailSeconds, (double)s.expectedTailSeconds)
+                                : s.expectedTailSeconds;
+}
+
+inline PlanEstimate estimatePlan(const JobTable &jobs, const EstimateSettings &s)
+{
+    PlanEstimate res;
+    res.jobs = jobs.size();
+
+    static constexpr double wavHeaderBytes{80};
+    auto nv = std::max(s.nVoices, 1);
+    double batchLongest{0}, totalWall{0};
+    for (size_t i = 0; i < jobs.size(); ++i)
+    {
+        auto j = jobs[i];
+        auto recorded = j.gateSeconds + tailSeconds(j, s);
+        auto wall = recorded + s.latencySeconds + s.spindownSeconds;
+
+        auto samples = recorded * s.sampleRate * s.nChannels;
+        res.bytes += samples * sizeof(float) + wavHeaderBytes;
+        if (!s.extraFirstRROnly || j.roundRobinIndex == 0)
+            res.bytes += samples * s.extraBytesPerSample;
+
+        totalWall += wall;
+        batchLongest = std::max(batchLongest, wall);
+        if (s.lockstep && ((i + 1) % nv == 0 || i + 1 == jobs.size()))
+        {
+            res.seconds += batchLongest;
+            batchLongest = 0;
+        }
+    }
+    if (!s.lockstep)
+        res.seconds = totalWall / std::min((size_t)nv, std::max(jobs.size(), (size_t)1));
+    return res;
+}
+
+inline std::string formatDuration(double seconds)
+{
+    auto t = (long)std::ceil(seconds);
+    char res[64];
+    if (t >= 3600)
+        snprintf(res, sizeof(res), "%ldh%02ldm", t / 3600, (t / 60) % 60);
+    else if (t >= 60)
+        snprintf(res, sizeof(res), "%ldm%02lds", t / 60, t % 60);
+    else
+        snprintf(res, sizeof(res), "%lds", t);
+    return res;
+}
+
+inline std::string formatBytes(double bytes)
+{
+    char res[64];
+    if (bytes >= 1024.0 * 1024 * 1024)
+        snprintf(res, sizeof(res), "%.1f GB", bytes / (1024.0 * 1024 * 1024));
+    else
+        snprintf(res, sizeof(res), "%.0f MB", std::ceil(bytes / (1024.0 * 1024)));
+    return res;
+}
+} // namespace baconpaul::samplecreator::estimate
+#endif // SAMPLECREATOR_PLANESTIMATOR_HPP
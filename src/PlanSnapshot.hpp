@@ -0,0 +1,72 @@
+/*
+ * SampleCreator
+ *
+ * An experimental idea based on a preliminary convo. Probably best to come back later.
+ *
+ * Copyright Paul Walker 2024
+ *
+ * Released under the MIT License. See `LICENSE.md` for details
+ */
+
+#ifndef SRC_PLANSNAPSHOT_HPP
+#define SRC_PLANSNAPSHOT_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "JobTable.hpp"
+#include "Progressive.hpp"
+
+namespace baconpaul::samplecreator
+{
+/*
+ * A render plan which never changes once published. The audio thread, the render thread
+ * and the UI each hold a reference to the snapshot they are working from, so a new plan
+ * never moves memory out from under any of them and nobody copies the job table. The
+ * version increases with every publish; a reader compares it with the one it last saw
+ * and only reloads when it differs.
+ *
+ * A plan made for a render also carries the order to render it in and its passes.
+ */
+struct PlanSnapshot
+{
+    uint64_t version{0};
+    JobTable jobs;
+    std::vector<int64_t> order;
+    progressive::PassPlan passes;
+    int nVoices{1}; // the polyphony the order was made for
+};
+using PlanPtr = std::shared_ptr<const PlanSnapshot>;
+
+/*
+ * The latest snapshot. The shared_ptr is only touched through the atomic free functions,
+ * which may take a lock inside the standard library, so never publish from the audio
+ * thread. Both the UI (as a render starts) and the plan worker publish, so numbering and
+ * storing happen under one lock; otherwise an older plan could be stored last with the
+ * newer version already handed out. Readers take the version from the snapshot they
+ * load, never separately.
+ */
+struct PlanPublisher
+{
+    PlanPtr publish(std::shared_ptr<PlanSnapshot> p)
+    {
+        std::lock_guard<std::mutex> g(publishLock);
+        p->version = ++lastVersion;
+        PlanPtr res = std::move(p);
+        std::atomic_store(&latest, res);
+        return res;
+    }
+
+    PlanPtr load() const { return std::atomic_load(&latest); }
+    uint64_t version() const { return load()->version; }
+
+  protected:
+    PlanPtr latest{std::make_shared<PlanSnapshot>()};
+    std::mutex publishLock;
+    uint64_t lastVersion{0}; // guarded by publishLock
+};
+} // namespace baconpaul::samplecreator
+#endif // SAMPLECREATOR_PLANSNAPSHOT_HPP
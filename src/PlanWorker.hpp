@@ -0,0 +1,169 @@
+/*
+ * SampleCreator
+ *
+ * An experimental idea based on a preliminary convo. Probably best to come back later.
+ *
+ * Copyright Paul Walker 2024
+ *
+ * Released under the MIT License. See `LICENSE.md` for details
+ */
+
+#ifndef SRC_PLANWORKER_HPP
+#define SRC_PLANWORKER_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <tuple>
+
+#include "JobTable.hpp"
+
+namespace baconpaul::samplecreator::planworker
+{
+/*
+ * Runs the latest of a stream of requests on a thread of its own. Dragging a knob asks for
+ * a new plan every frame; each request replaces the one pending, and the work only runs
+ * once the requests have been quiet for the debounce time (or have been arriving for
+ * maxWait, so a long drag still updates). The UI never waits on building a big plan, and
+ * we build a handful per gesture rather than one per frame.
+ */
+template <typename Request> struct DebouncedWorker
+{
+    using clock_t = std::chrono::steady_clock;
+    using work_t = std::function<void(const Request &)>;
+
+    DebouncedWorker(work_t w, std::chrono::milliseconds debounce,
+                    std::chrono::milliseconds maxWait)
+        : work(std::move(w)), debounce(debounce), maxWait(maxWait)
+    {
+    }
+    ~DebouncedWorker() { stop(); }
+
+    // The thread starts with the first request, so an idle module never has one
+    void request(const Request &r)
+    {
+        {
+            std::lock_guard<std::mutex> g(lock);
+            if (!running)
+                return;
+            auto now = clock_t::now();
+            if (!pending.has_value())
+                firstRequestAt = now;
+            pending = r;
+            lastRequestAt = now;
+            if (!thread)
+                thread = std::make_unique<std::thread>([this]() { run(); });
+        }
+        cv.notify_one();
+    }
+
+    void stop()
+    {
+        {
+            std::lock_guard<std::mutex> g(lock);
+            running = false;
+        }
+        cv.notify_one();
+        if (thread)
+        {
+            thread->join();
+            thread.reset();
+        }
+    }
+
+  protected:
+    void run()
+    {
+        std::unique_lock<std::mutex> g(lock);
+        while (running)
+        {
+            if (!pending.has_value())
+            {
+                cv.wait(g);
+                continue;
+            }
+            auto due = std::min(lastRequestAt + debounce, firstRequestAt + maxWait);
+            if (clock_t::now() < due)
+            {
+                cv.wait_until(g, due);
+                continue;
+            }
+            auto r = std::move(*pending);
+            pending.reset();
+            g.unlock();
+            work(r);
+            g.lock();
+        }
+    }
+
+    work_t work;
+    std::chrono::milliseconds debounce, maxWait;
+
+    std::mutex lock;
+    std::condition_variable cv;
+    std::optional<Request> pending;
+    clock_t::time_point firstRequestAt, lastRequestAt;
+    bool running{true};
+    std::unique_ptr<std::thread> thread;
+};
+
+/*
+ * The plan is a run of note columns, and every column's jobs depend only on its notes and
+ * on the settings which shape the layers (velocities, round robins, gate, curves, seed).
+ * So while those settings stay put, a new plan can take the jobs of any column the last
+ * plan also had, and only build the ones which moved. Dragging the midi range at a step
+ * of one builds just the notes added; changing a layer setting builds everything.
+ */
+struct NoteColumn
+{
+    int midiNote{0}, noteFrom{0}, noteTo{0};
+    bool operator<(const NoteColumn &o) const
+    {
+        return std::tie(midiNote, noteFrom, noteTo) < std::tie(o.midiNote, o.noteFrom, o.noteTo);
+    }
+};
+
+template <typename LayerSettings> struct ColumnCache
+{
+    void beginPlan(const LayerSettings &s)
+    {
+        if (!valid || !(s == settings))
+            columns.clear();
+        settings = s;
+        valid = true;
+        next.clear();
+    }
+
+    // makeColumn(JobTable &, const NoteColumn &) fills in a column we don't have
+    template <typename F> void appendColumn(JobTable &onto, const NoteColumn &c, F makeColumn)
+    {
+        JobTable col;
+        auto it = columns.find(c);
+        if (it != columns.end())
+        {
+            col = std::move(it->second);
+        }
+        else
+        {
+            makeColumn(col, c);
+        }
+        for (auto j : col)
+            onto.push_back(j);
+        next[c] = std::move(col);
+    }
+
+    void endPlan() { columns.swap(next); }
+
+  protected:
+    bool valid{false};
+    LayerSettings settings;
+    std::map<NoteColumn, JobTable> columns, next;
+};
+} // namespace baconpaul::samplecreator::planworker
+#endif // SAMPLECREATOR_PLANWORKER_HPP
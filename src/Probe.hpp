@@ -0,0 +1,342 @@
+/*
+ * SampleCreator
+ *
+ * An experimental idea based on a preliminary convo. Probably best to come back later.
+ *
+ * Copyright Paul Walker 2024
+ *
+ * Released under the MIT License. See `LICENSE.md` for details
+ */
+
+#ifndef SRC_PROBE_HPP
+#define SRC_PROBE_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <numeric>
+#include <vector>
+
+#include <rack.hpp>
+
+#include "RenderJob.hpp"
+
+namespace baconpaul::samplecreator::probe
+{
+/*
+ * A probe plays a handful of short notes through the patch and keeps them in memory, so
+ * we can ask questions of the patch which shape the plan before spending hours on a
+ * render. The UI thread builds the run and allocates every buffer, the audio thread plays
+ * and records it, and the render thread analyses it.
+ */
+enum Kind
+{
+    ROUND_ROBIN,
+    KEY_ZONES,
+    VELOCITY_LAYERS
+};
+
+struct ProbeNote
+{
+    int midiNote{60};
+    int velocity{127};
+    float rrRand[RenderJob::nRRVoltages]{0.f, 0.f};
+};
+
+struct ProbeTake
+{
+    ProbeNote note;
+    std::vector<float> L, R; // allocated to capacity before the audio thread sees them
+    size_t frames{0};
+};
+
+struct ProbeRun
+{
+    Kind kind{ROUND_ROBIN};
+    float sampleRate{48000.f};
+    float gateSeconds{0.5f};
+    std::vector<ProbeTake> takes;
+
+    void add(const ProbeNote &n)
+    {
+        ProbeTake t;
+        t.note = n;
+        takes.push_back(t);
+    }
+
+    // Room in every take for the gate and up to maxTailSeconds of release
+    void allocate(float maxTailSeconds)
+    {
+        auto cap = (size_t)std::ceil(sampleRate * (gateSeconds + maxTailSeconds));
+        for (auto &t : takes)
+        {
+            t.L.assign(cap, 0.f);
+            t.R.assign(cap, 0.f);
+            t.frames = 0;
+        }
+    }
+};
+
+/*
+ * The largest normalized cross correlation of two takes over lags of up to maxLag frames,
+ * so a patch whose attack jitters by a few samples still compares as itself. It ignores
+ * gain: 1 is the same waveform at any level. A silent take matches nothing, not even
+ * another silent one; check the level with peakDb before reading anything into it.
+ */
+inline float normalizedCrossCorrelation(const ProbeTake &a, const ProbeTake &b, int maxLag)
+{
+    auto n = (int64_t)std::min(a.frames, b.frames);
+    double ea{0}, eb{0};
+    for (int64_t i = 0; i < n; ++i)
+    {
+        ea += a.L[i] * a.L[i] + a.R[i] * a.R[i];
+        eb += b.L[i] * b.L[i] + b.R[i] * b.R[i];
+    }
+    if (ea <= 0 || eb <= 0)
+        return 0.f;
+
+    double best{-1};
+    for (int lag = -maxLag; lag <= maxLag; ++lag)
+    {
+        double s{0};
+        auto from = std::max((int64_t)0, (int64_t)-lag);
+        auto to = std::min(n, n - lag);
+        for (int64_t i = from; i < to; ++i)
+            s += a.L[i] * b.L[i + lag] + a.R[i] * b.R[i + lag];
+        best = std::max(best, s);
+    }
+    return (float)(best / std::sqrt(ea * eb));
+}
+
+/*
+ * The spectral envelope of a take: the average power over Hann windowed frames, summed
+ * into bands a third of an octave wide from lowestBandHz up, in dB. Coarse enough to
+ * ignore phase and the exact partials, fine enough to tell one timbre from another.
+ *
+ * Fixed bands move with pitch, though: the same timbre an octave up lands a few bands
+ * over. To compare notes of different pitches use harmonicBands, which sums the power
+ * around each multiple of the fundamental, so band h is harmonic h at any pitch.
+ */
+struct SpectrumAnalyzer
+{
+    static constexpr size_t frameSize{2048}, hop{1024};
+    static constexpr float lowestBandHz{40.f};
+    static constexpr int maxHarmonics{24};
+
+    rack::dsp::RealFFT fft{frameSize};
+    std::vector<float> window, in, out, power;
+
+    SpectrumAnalyzer() : window(frameSize), in(frameSize), out(2 * frameSize)
+    {
+        for (size_t i = 0; i < frameSize; ++i)
+            window[i] = 0.5f - 0.5f * std::cos(2.0 * M_PI * i / frameSize);
+    }
+
+    // The average power per bin over the frames of t, into power
+    void measure(const ProbeTake &t)
+    {
+        power.assign(frameSize / 2 + 1, 0.f);
+        int nFrames{0};
+        size_t start{0};
+        do
+        {
+            for (size_t i = 0; i < frameSize; ++i)
+            {
+                auto s = start + i;
+                in[i] = s < t.frames ? 0.5f * (t.L[s] + t.R[s]) * window[i] : 0.f;
+            }
+            fft.rfft(in.data(), out.data());
+            power[0] += out[0] * out[0];
+            power[frameSize / 2] += out[1] * out[1];
+            for (size_t k = 1; k < frameSize / 2; ++k)
+                power[k] += out[2 * k] * out[2 * k] + out[2 * k + 1] * out[2 * k + 1];
+            nFrames++;
+            start += hop;
+        } while (start + frameSize <= t.frames);
+        for (auto &p : power)
+            p /= nFrames;
+    }
+
+    std::vector<float> bands(const ProbeTake &t, float sampleRate)
+    {
+        measure(t);
+        std::vector<float> res;
+        auto binHz = sampleRate / frameSize;
+        auto third = std::pow(2.f, 1.f / 3.f);
+        for (float lo = lowestBandHz; lo * third < sampleRate * 0.5f; lo *= third)
+        {
+            auto b0 = (size_t)std::ceil(lo / binHz);
+            auto b1 = (size_t)std::ceil(lo * third / binHz);
+            if (b1 <= b0)
+                continue; // narrower than a bin; the same for every take at this rate
+            double p{0};
+            for (auto k = b0; k < b1 && k < power.size(); ++k)
+                p += power[k];
+            res.push_back((float)(10.0 * std::log10(p + 1e-14)));
+        }
+        return res;
+    }
+
+    // The power within half a fundamental of each harmonic of f0 below nyquist, in dB
+    std::vector<float> harmonicBands(const ProbeTake &t, float sampleRate, float f0)
+    {
+        measure(t);
+        std::vector<float> res;
+        auto binHz = sampleRate / frameSize;
+        for (int h = 1; h <= maxHarmonics && (h + 0.5f) * f0 < sampleRate * 0.5f; ++h)
+        {
+            auto b0 = (size_t)std::ceil((h - 0.5f) * f0 / binHz);
+            auto b1 = (size_t)std::ceil((h + 0.5f) * f0 / binHz);
+            if (b1 <= b0)
+            {
+                // a fundamental narrower than a bin; take the bin the harmonic falls in
+                b0 = (size_t)std::round(h * f0 / binHz);
+                b1 = b0 + 1;
+            }
+            double p{0};
+            for (auto k = b0; k < b1 && k < power.size(); ++k)
+                p += power[k];
+            res.push_back((float)(10.0 * std::log10(p + 1e-14)));
+        }
+        return res;
+    }
+
+    // The spectral centroid of the take measure() last saw
+    float centroidHz(float sampleRate) const
+    {
+        double num{0}, den{0};
+        for (size_t k = 1; k < power.size(); ++k)
+        {
+            num += power[k] * k * sampleRate / frameSize;
+            den += power[k];
+        }
+        return den > 0 ? (float)(num / den) : 0.f;
+    }
+};
+
+// The largest absolute sample of a take in dBFS, no lower than floorDb
+inline float peakDb(const ProbeTake &t, float floorDb = -90.f)
+{
+    float best{0};
+    for (size_t i = 0; i < t.frames; ++i)
+        best = std::max({best, std::fabs(t.L[i]), std::fabs(t.R[i])});
+    return std::max(floorDb, 20.f * std::log10(best + 1e-20f));
+}
+
+// The loudest RMS over windowFrames long stretches of a take, in dB, no lower than floorDb
+inline float peakRmsDb(const ProbeTake &t, size_t windowFrames, float floorDb = -90.f)
+{
+    windowFrames = std::max(windowFrames, (size_t)1);
+    double sum{0}, best{0};
+    for (size_t i = 0; i < t.frames; ++i)
+    {
+        sum += 0.5 * (t.L[i] * t.L[i] + t.R[i] * t.R[i]);
+        if (i >= windowFrames)
+            sum -= 0.5 * (t.L[i - windowFrames] * t.L[i - windowFrames] +
+                          t.R[i - windowFrames] * t.R[i - windowFrames]);
+        best = std::max(best, sum / windowFrames);
+    }
+    return std::max(floorDb, (float)(10.0 * std::log10(best + 1e-20)));
+}
+
+/*
+ * The RMS difference of two band spectra in dB, over the bands where either is within
+ * rangeDb of the louder one's peak, so we don't compare noise floors.
+ */
+inline float spectralDistanceDb(const std::vector<float> &a, const std::vector<float> &b,
+                                float rangeDb = 60.f)
+{
+    auto n = std::min(a.size(), b.size());
+    if (n == 0)
+        return 0.f;
+    auto peak = std::max(*std::max_element(a.begin(), a.begin() + n),
+                         *std::max_element(b.begin(), b.begin() + n));
+    double sum{0};
+    int count{0};
+    for (size_t i = 0; i < n; ++i)
+    {
+        if (std::max(a[i], b[i]) < peak - rangeDb)
+            continue;
+        auto d = a[i] - b[i];
+        sum += d * d;
+        count++;
+    }
+    return count ? (float)std::sqrt(sum / count) : 0.f;
+}
+
+// The same bands with the loudest at 0 dB, so comparing them compares timbre, not level
+inline std::vector<float> levelNormalized(std::vector<float> bands)
+{
+    if (bands.empty())
+        return bands;
+    auto peak = *std::max_element(bands.begin(), bands.end());
+    for (auto &b : bands)
+        b -= peak;
+    return bands;
+}
+
+/*
+ * Adaptive key zones and velocity layers. We probe a grid of at most maxProbes notes (or
+ * velocities) from lo to hi, always including both, measure how much the sound changes
+ * between each pair of neighbours, and then place up to maxPoints sample points so each
+ * zone spans about the same amount of change. The change between two probes is spread
+ * evenly over the values between them, with uniformShare of the average added everywhere
+ * so a stretch where nothing changes can still get the odd point. Points sit at the
+ * middle of equal shares of the total, so zones are narrow where the sound moves quickly.
+ */
+inline std::vector<int> probeGrid(int lo, int hi, int maxProbes)
+{
+    if (lo > hi)
+        std::swap(lo, hi);
+    auto step = std::max(1, (int)std::ceil((hi - lo) / (double)std::max(maxProbes - 1, 1)));
+    std::vector<int> res;
+    for (auto n = lo; n < hi; n += step)
+        res.push_back(n);
+    res.push_back(hi);
+    return res;
+}
+
+inline std::vector<int> placeByChange(const std::vector<int> &probes,
+                                      const std::vector<float> &change, int maxPoints,
+                                      float uniformShare = 0.25f)
+{
+    std::vector<int> res;
+    if (probes.empty() || maxPoints <= 0)
+        return res;
+    auto lo = probes.front(), hi = probes.back();
+    if (hi - lo + 1 <= maxPoints || probes.size() < 2 || change.size() + 1 != probes.size())
+    {
+        for (auto n = lo; n <= hi; n += std::max(1, (hi - lo + 1) / std::max(maxPoints, 1)))
+            res.push_back(n);
+        return res;
+    }
+
+    auto mean = std::accumulate(change.begin(), change.end(), 0.0) / change.size();
+    std::vector<double> perStep(hi - lo, 1.0);
+    if (mean > 0)
+    {
+        for (size_t i = 0; i < change.size(); ++i)
+        {
+            auto width = probes[i + 1] - probes[i];
+            for (auto n = probes[i]; n < probes[i + 1]; ++n)
+                perStep[n - lo] = (change[i] + uniformShare * mean) / width;
+        }
+    }
+
+    std::vector<double> cumulative(perStep.size() + 1, 0.0);
+    std::partial_sum(perStep.begin(), perStep.end(), cumulative.begin() + 1);
+    auto total = cumulative.back();
+    for (int k = 0; k < maxPoints; ++k)
+    {
+        auto target = (k + 0.5) * total / maxPoints;
+        auto it = std::upper_bound(cumulative.begin(), cumulative.end(), target);
+        auto seg = std::clamp((int)(it - cumulative.begin()) - 1, 0, (int)perStep.size() - 1);
+        auto frac = (target - cumulative[seg]) / std::max(perStep[seg], 1e-12);
+        auto point = std::clamp((int)std::round(lo + seg + frac), lo, hi);
+        if (res.empty() || point > res.back())
+            res.push_back(point);
+    }
+    return res;
+}
+} // namespace baconpaul::samplecreator::probe
+#endif // SAMPLECREATOR_PROBE_HPP
@@ -0,0 +1,164 @@
+/*
+ * SampleCreator
+ *
+ * An experimental idea based on a preliminary convo. Probably best to come back later.
+ *
+ * Copyright Paul Walker 2024
+ *
+ * Released under the MIT License. See `LICENSE.md` for details
+ */
+
+#ifndef SRC_PROGRESSIVE_HPP
+#define SRC_PROGRESSIVE_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <map>
+#include <set>
+#include <tuple>
+#include <vector>
+
+#include "JobTable.hpp"
+
+namespace baconpaul::samplecreator::progressive
+{
+/*
+ * Coarse to fine rendering. The plan is split into passes: about one note an octave
+ * (always with the lowest and highest) at the middle velocity and the first round robin,
+ * then each pass halves the gap between notes, then the other velocity layers and lastly
+ * the other round robins. After each pass we write a multi-file which stretches the takes
+ * we have over the zones we don't, so you can audition a patch minutes into a long render.
+ */
+struct PassPlan
+{
+    std::vector<uint8_t> pass; // per job in the plan
+    int nPasses{0};
+};
+
+inline PassPlan coarseToFinePasses(const JobTable &jobs)
+{
+    PassPlan res;
+    res.pass.resize(jobs.size());
+    if (jobs.empty())
+        return res;
+
+    std::set<int> noteSet(jobs.midiNote.begin(), jobs.midiNote.end());
+    std::set<int> velSet(jobs.velocity.begin(), jobs.velocity.end());
+    std::vector<int> notes(noteSet.begin(), noteSet.end());
+    std::vector<int> vels(velSet.begin(), velSet.end());
+    auto middleVel = vels[vels.size() / 2];
+
+    // the largest power of two stride which keeps the first pass at or under an octave
+    int minStep{12};
+    for (size_t i = 1; i < notes.size(); ++i)
+        minStep = std::min(minStep, notes[i] - notes[i - 1]);
+    auto perOctave = std::max(1, 12 / std::max(minStep, 1));
+    int levels{0};
+    while ((2 << levels) <= perOctave)
+        levels++;
+    auto stride = 1 << levels;
+
+    std::map<int, int> noteLevel;
+    auto nn = (int)notes.size();
+    for (int i = 0; i < nn; ++i)
+    {
+        int lv{0};
+        if (i % stride != 0 && i != nn - 1)
+        {
+            int tz{0};
+            while (((i >> tz) & 1) == 0)
+                tz++;
+            lv = levels - tz;
+        }
+        noteLevel[notes[i]] = lv;
+    }
+
+    auto velocityPass = levels + 1;
+    auto rrPass = levels + 2;
+    for (size_t i = 0; i < jobs.size(); ++i)
+    {
+        if (jobs.roundRobinIndex[i] > 0)
+            res.pass[i] = rrPass;
+        else if (jobs.velocity[i] != middleVel)
+            res.pass[i] = velocityPass;
+        else
+            res.pass[i] = noteLevel[jobs.midiNote[i]];
+    }
+    res.nPasses = rrPass + 1;
+    return res;
+}
+
+/*
+ * Make a partial set of takes playable across the whole plan. Within each velocity layer
+ * and round robin the notes we have are widened to meet halfway across the ones we don't,
+ * the velocity layers we have are widened the same way, and the round robins are
+ * renumbered over those present. A complete set of takes comes back unchanged.
+ */
+inline std::vector<Take> stretchToPlan(const std::vector<Take> &takes, const JobTable &plan)
+{
+    if (takes.empty() || plan.empty())
+        return takes;
+
+    int noteLo = *std::min_element(plan.noteFrom.begin(), plan.noteFrom.end());
+    int noteHi = *std::max_element(plan.noteTo.begin(), plan.noteTo.end());
+    int velLo = *std::min_element(plan.velFrom.begin(), plan.velFrom.end());
+    int velHi = *std::max_element(plan.velTo.begin(), plan.velTo.end());
+
+    auto res = takes;
+    using layer_t = std::pair<int, int>; // the velFrom and velTo the plan gave the layer
+
+    // meet halfway across any gap between neighbours, and stretch the ends to the edges
+    auto widen = [](std::vector<std::pair<int *, int *>> &ranges, int lo, int hi) {
+        std::sort(ranges.begin(), ranges.end(),
+                  [](const auto &a, const auto &b) { return *a.first < *b.first; });
+        for (size_t i = 0; i + 1 < ranges.size(); ++i)
+        {
+            auto &to = *ranges[i].second;
+            auto &from = *ranges[i + 1].first;
+            if (from > to + 1)
+            {
+                auto mid = (to + from) / 2;
+                to = mid;
+                from = mid + 1;
+            }
+        }
+        *ranges.front().first = std::min(*ranges.front().first, lo);
+        *ranges.back().second = std::max(*ranges.back().second, hi);
+    };
+
+    std::map<std::tuple<int, int, int>, std::vector<std::pair<int *, int *>>> byLayerAndRR;
+    for (auto &t : res)
+        byLayerAndRR[{t.job.velFrom, t.job.velTo, t.job.roundRobinIndex}].push_back(
+            {&t.job.noteFrom, &t.job.noteTo});
+    for (auto &[k, ranges] : byLayerAndRR)
+        widen(ranges, noteLo, noteHi);
+
+    std::map<layer_t, std::set<int>> rrsByLayer;
+    for (const auto &t : res)
+        rrsByLayer[{t.job.velFrom, t.job.velTo}].insert(t.job.roundRobinIndex);
+
+    std::vector<layer_t> layers;
+    for (const auto &[l, rrs] : rrsByLayer)
+        layers.push_back(l);
+    auto widened = layers;
+    std::vector<std::pair<int *, int *>> velRanges;
+    for (auto &l : widened)
+        velRanges.push_back({&l.first, &l.second});
+    widen(velRanges, velLo, velHi);
+    std::map<layer_t, layer_t> layerMap;
+    for (size_t i = 0; i < layers.size(); ++i)
+        layerMap[layers[i]] = widened[i];
+
+    for (auto &t : res)
+    {
+        const auto &rrs = rrsByLayer[{t.job.velFrom, t.job.velTo}];
+        t.job.roundRobinOutOf = (int)rrs.size();
+        t.job.roundRobinIndex = (int)std::distance(rrs.begin(), rrs.find(t.job.roundRobinIndex));
+        auto &wl = layerMap[{t.job.velFrom, t.job.velTo}];
+        t.job.velFrom = wl.first;
+        t.job.velTo = wl.second;
+    }
+    return res;
+}
+} // namespace baconpaul::samplecreator::progressive
+#endif // SAMPLECREATOR_PROGRESSIVE_HPP
@@ -0,0 +1,192 @@
+/*
+ * SampleCreator
+ *
+ * An experimental idea based on a preliminary convo. Probably best to come back later.
+ *
+ * Copyright Paul Walker 2024
+ *
+ * Released under the MIT License. See `LICENSE.md` for details
+ */
+
+#ifndef SRC_RIFFWAVREADER_HPP
+#define SRC_RIFFWAVREADER_HPP
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#include <ghc/filesystem.hpp>
+namespace fs = ghc::filesystem;
+
+namespace baconpaul::samplecreator::riffwav
+{
+/*
+ * The partner to the RIFFWavWriter. Reads back the F32 wav files we write, along with
+ * the inst block, a block of frames at a time so we never need a whole sample in memory.
+ */
+struct RIFFWavReader
+{
+    fs::path inPath{};
+    FILE *inf{nullptr};
+
+    uint16_t formatTag{0};
+    uint16_t nChannels{0};
+    int32_t sampleRate{0};
+    uint16_t bitsPerSample{0};
+
+    bool hasInst{false};
+    int keyRoot{60}, keyLow{0}, keyHigh{127}, velLow{1}, velHigh{127};
+
+    bool hasFingerprint{false};
+    uint64_t fingerprint{0};
+
+    // false if the writer never got to patch the sizes, i.e. the process died mid take.
+    // A take cut short by Stop is closed properly, so the module removes it instead.
+    bool headerComplete{false};
+
+    size_t dataStart{0};
+    size_t dataLen{0};
+    size_t framesRead{0};
+
+    std::string errMsg{};
+
+    RIFFWavReader() {}
+    RIFFWavReader(const fs::path &p) : inPath(p) {}
+    ~RIFFWavReader() { closeFile(); }
+
+    RIFFWavReader(const RIFFWavReader &) = delete;
+    RIFFWavReader &operator=(const RIFFWavReader &) = delete;
+
+    bool readc4(char f[4]) { return std::fread(f, 1, 4, inf) == 4; }
+    bool readi32(uint32_t &i) { return std::fread(&i, 1, sizeof(uint32_t), inf) == 4; }
+
+    [[nodiscard]] bool openFile()
+    {
+        closeFile();
+        hasInst = false;
+        hasFingerprint = false;
+        headerComplete = false;
+        dataStart = 0;
+        dataLen = 0;
+        framesRead = 0;
+
+        inf = fopen(inPath.u8string().c_str(), "rb");
+        if (!inf)
+        {
+            errMsg = "Unable to open '" + inPath.u8string() + "' for reading";
+            return false;
+        }
+
+        char c4[4];
+        uint32_t sz, riffSize{0};
+        if (!readc4(c4) || memcmp(c4, "RIFF", 4) != 0 || !readi32(riffSize) || !readc4(c4) ||
+            memcmp(c4, "WAVE", 4) != 0)
+        {
+            errMsg = "'" + inPath.filename().u8string() + "' is not a RIFF WAVE file";
+            closeFile();
+            return false;
+        }
+
+        bool hasFmt{false};
+        while (readc4(c4) && readi32(sz))
+        {
+            auto chunkStart = std::ftell(inf);
+            if (memcmp(c4, "fmt ", 4) == 0 && sz >= 16)
+            {
+                unsigned char fmt[16];
+                if (std::fread(fmt, 1, 16, inf) != 16)
+                    break;
+                memcpy(&formatTag, fmt, 2);
+                memcpy(&nChannels, fmt + 2, 2);
+                memcpy(&sampleRate, fmt + 4, 4);
+                memcpy(&bitsPerSample, fmt + 14, 2);
+                hasFmt = true;
+            }
+            else if (memcmp(c4, "inst", 4) == 0 && sz >= 7)
+            {
+                signed char inst[7];
+                if (std::fread(inst, 1, 7, inf) != 7)
+                    break;
+                keyRoot = inst[0];
+                keyLow = inst[3];
+                keyHigh = inst[4];
+                velLow = inst[5];
+                velHigh = inst[6];
+                hasInst = true;
+            }
+            else if (memcmp(c4, "scfp", 4) == 0 && sz >= 8)
+            {
+                if (std::fread(&fingerprint, 1, 8, inf) != 8)
+                    break;
+                hasFingerprint = true;
+            }
+            else if (memcmp(c4, "data", 4) == 0)
+            {
+                dataStart = chunkStart;
+                dataLen = sz;
+            }
+
+            // chunks are word aligned
+            if (std::fseek(inf, chunkStart + sz + (sz & 1), SEEK_SET))
+                break;
+        }
+
+        if (!hasFmt || dataStart == 0)
+        {
+            errMsg = "'" + inPath.filename().u8string() + "' has no fmt or data chunk";
+            closeFile();
+            return false;
+        }
+        if (formatTag != 3 || bitsPerSample != 32 || nChannels == 0)
+        {
+            errMsg = "'" + inPath.filename().u8string() + "' is not a 32 bit float wav";
+            closeFile();
+            return false;
+        }
+
+        // a file which was never closed properly has a zero data size, so use the file
+        std::fseek(inf, 0, SEEK_END);
+        auto fileEnd = (size_t)std::ftell(inf);
+        headerComplete = riffSize == fileEnd - 8 && dataLen > 0 && dataStart + dataLen <= fileEnd;
+        if (dataLen == 0 || dataStart + dataLen > fileEnd)
+            dataLen = fileEnd - dataStart;
+
+        std::fseek(inf, dataStart, SEEK_SET);
+        return true;
+    }
+
+    bool isOpen() { return inf != nullptr; }
+    void closeFile()
+    {
+        if (inf)
+        {
+            std::fclose(inf);
+            inf = nullptr;
+        }
+    }
+
+    [[nodiscard]] size_t getSampleCount() const
+    {
+        return nChannels ? dataLen / (nChannels * sizeof(float)) : 0;
+    }
+
+    bool rewind()
+    {
+        framesRead = 0;
+        return inf && std::fseek(inf, dataStart, SEEK_SET) == 0;
+    }
+
+    // Reads up to nFrames interleaved frames into d, returning the number read
+    size_t readInterleavedBlock(float *d, size_t nFrames)
+    {
+        if (!inf)
+            return 0;
+        nFrames = std::min(nFrames, getSampleCount() - framesRead);
+        auto res = std::fread(d, nChannels * sizeof(float), nFrames, inf);
+        framesRead += res;
+        return res;
+    }
+};
+} // namespace baconpaul::samplecreator::riffwav
+#endif // SAMPLECREATOR_RIFFWAVREADER_HPP
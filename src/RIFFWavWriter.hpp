@@ -80,6 +80,15 @@ struct RIFFWavWriter
         pushi8(0);
     }
 
+    // Our own chunk, which other readers skip. See fingerprint in RenderJob.hpp
+    void writeFingerprintChunk(uint64_t fp)
+    {
+        pushc4('s', 'c', 'f', 'p');
+        pushi32(8);
+        pushi32((int32_t)(fp & 0xFFFFFFFF));
+        pushi32((int32_t)(fp >> 32));
+    }
+
     void startDataChunk()
     {
         pushc4('d', 'a', 't', 'a');
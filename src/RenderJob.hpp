@@ -0,0 +1,114 @@
+/*
+ * SampleCreator
+ *
+ * An experimental idea based on a preliminary convo. Probably best to come back later.
+ *
+ * Copyright Paul Walker 2024
+ *
+ * Released under the MIT License. See `LICENSE.md` for details
+ */
+
+#ifndef SRC_RENDERJOB_HPP
+#define SRC_RENDERJOB_HPP
+
+#include <cstdint>
+#include <cstring>
+
+#include <ghc/filesystem.hpp>
+namespace fs = ghc::filesystem;
+
+namespace baconpaul::samplecreator
+{
+/*
+ * A single note / velocity / round robin to record. The module generates these
+ * in populateRenderJobs and the various writers consume them.
+ */
+struct RenderJob
+{
+    int midiNote, noteFrom, noteTo;
+    int velocity{90}, velFrom, velTo;
+    int roundRobinIndex{0};
+    int roundRobinOutOf{1};
+    static constexpr int nRRVoltages{2}; // one per RR output
+    float rrRand[nRRVoltages]{0.f, 0.f};
+
+    // the gate time and longest release tail for this job, with the key and velocity
+    // curves applied. A maxTailSeconds of 0 is no limit.
+    float gateSeconds{1.f};
+    float maxTailSeconds{0.f};
+};
+
+/*
+ * The render wide settings which change what a take sounds like, captured when a render
+ * starts.
+ */
+struct RenderSettings
+{
+    float gateTime{1.f};
+    int releaseMode{0};
+    int latency{0};
+    int sampleRate{48000};
+    int nChannels{1}; // a mono take is no use once INPUT_R is patched
+    int silenceMode{0};
+    float silenceThresholdDb{-120.f};
+    float silenceHoldMs{85.f};
+    float maxTailSeconds{0.f};
+    bool trimLeadingSilence{false};
+    bool adaptiveGate{false};
+    float adaptiveGateMinSeconds{0.25f};
+    float adaptiveGateHoldSeconds{0.5f};
+};
+
+/*
+ * Identifies a take by everything which went into recording it. We write it into each wav
+ * so a re-render can skip the jobs it has already recorded with the same settings.
+ */
+static constexpr uint32_t fingerprintVersion{4};
+inline uint64_t fingerprint(const RenderJob &j, const RenderSettings &s)
+{
+    // FNV-1a over the 32 bit words
+    uint64_t h{14695981039346656037ULL};
+    auto mix = [&h](uint32_t w) { h = (h ^ w) * 1099511628211ULL; };
+    auto mixf = [&mix](float f) {
+        uint32_t w;
+        memcpy(&w, &f, sizeof(w));
+        mix(w);
+    };
+
+    mix(fingerprintVersion);
+    for (auto i : {j.midiNote, j.noteFrom, j.noteTo, j.velocity, j.velFrom, j.velTo,
+                   j.roundRobinIndex, j.roundRobinOutOf})
+        mix((uint32_t)i);
+    for (auto r : j.rrRand)
+        mixf(r);
+    mixf(j.gateSeconds);
+    mixf(j.maxTailSeconds);
+
+    mixf(s.gateTime);
+    mix((uint32_t)s.releaseMode);
+    mix((uint32_t)s.latency);
+    mix((uint32_t)s.sampleRate);
+    mix((uint32_t)s.nChannels);
+    mix((uint32_t)s.silenceMode);
+    mixf(s.silenceThresholdDb);
+    mixf(s.silenceHoldMs);
+    mixf(s.maxTailSeconds);
+    mix(s.trimLeadingSilence);
+    mix(s.adaptiveGate);
+    mixf(s.adaptiveGateMinSeconds);
+    mixf(s.adaptiveGateHoldSeconds);
+    return h;
+}
+
+/*
+ * A finished recording of a job; what the multi-file writers need to reference it.
+ * The path is relative to the sample (wav or raw) directory.
+ */
+struct Take
+{
+    RenderJob job;
+    fs::path relativePath{};
+    size_t sampleCount{0};
+};
+} // namespace baconpaul::samplecreator
+#endif // SAMPLECREATOR_RENDERJOB_HPP
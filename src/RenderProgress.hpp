@@ -0,0 +1,137 @@
+/*
+ * SampleCreator
+ *
+ * An experimental idea based on a preliminary convo. Probably best to come back later.
+ *
+ * Copyright Paul Walker 2024
+ *
+ * Released under the MIT License. See `LICENSE.md` for details
+ */
+
+#ifndef SRC_RENDERPROGRESS_HPP
+#define SRC_RENDERPROGRESS_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+
+namespace baconpaul::samplecreator::progress
+{
+/*
+ * A least squares fit of y = a + b * note + c * velocity over the takes seen so far. We fit
+ * the part of each take beyond its gate (the tail, less anything an adaptive gate saved)
+ * since that is the part we can't know in advance, and it mostly follows key and velocity.
+ * Until there are enough takes for a fit we fall back to the mean.
+ */
+struct KeyVelocityModel
+{
+    double n{0};
+    double sx{0}, sv{0}, sy{0};
+    double sxx{0}, sxv{0}, svv{0}, sxy{0}, svy{0};
+
+    void reset() { *this = KeyVelocityModel(); }
+
+    void add(double note, double vel, double y)
+    {
+        n += 1;
+        sx += note;
+        sv += vel;
+        sy += y;
+        sxx += note * note;
+        sxv += note * vel;
+        svv += vel * vel;
+        sxy += note * y;
+        svy += vel * y;
+    }
+
+    // y = a + b * note + c * velocity, or the mean while the fit isn't possible
+    struct Fit
+    {
+        double a{0}, b{0}, c{0};
+    };
+    Fit fit() const
+    {
+        if (n < 1)
+            return {};
+        auto mean = sy / n;
+        if (n < 4)
+            return {mean, 0, 0};
+
+        // Solve the 3x3 normal equations by Cramer's rule
+        double m[3][3]{{n, sx, sv}, {sx, sxx, sxv}, {sv, sxv, svv}};
+        double r[3]{sy, sxy, svy};
+        auto det3 = [](double a[3][3]) {
+            return a[0][0] * (a[1][1] * a[2][2] - a[1][2] * a[2][1]) -
+                   a[0][1] * (a[1][0] * a[2][2] - a[1][2] * a[2][0]) +
+                   a[0][2] * (a[1][0] * a[2][1] - a[1][1] * a[2][0]);
+        };
+        auto d = det3(m);
+        if (std::fabs(d) < 1e-9 * std::max(1.0, n * n * n))
+            return {mean, 0, 0}; // every take so far at one note or one velocity
+
+        double coef[3];
+        for (int c = 0; c < 3; ++c)
+        {
+            double mc[3][3];
+            for (int i = 0; i < 3; ++i)
+                for (int j = 0; j < 3; ++j)
+                    mc[i][j] = (j == c) ? r[i] : m[i][j];
+            coef[c] = det3(mc) / d;
+        }
+        return {coef[0], coef[1], coef[2]};
+    }
+};
+
+/*
+ * The jobs still to render, kept as the sums a linear fit needs, so predicting the time
+ * they take together costs the same however many there are.
+ */
+struct RemainingJobs
+{
+    double count{0}, gateSeconds{0}, note{0}, vel{0};
+
+    void reset() { *this = RemainingJobs(); }
+    void add(double gate, double nt, double v)
+    {
+        count += 1;
+        gateSeconds += gate;
+        note += nt;
+        vel += v;
+    }
+    void remove(double gate, double nt, double v)
+    {
+        count -= 1;
+        gateSeconds -= gate;
+        note -= nt;
+        vel -= v;
+    }
+
+    // The gates plus the tails the model predicts, in recorded seconds
+    double predictSeconds(const KeyVelocityModel &m) const
+    {
+        if (count <= 0)
+            return 0;
+        auto f = m.fit();
+        return gateSeconds + std::max(0.0, f.a * count + f.b * note + f.c * vel);
+    }
+};
+
+/*
+ * What the render thread publishes for the UI as takes complete. Also saved with the patch
+ * so you can see how the last render went.
+ */
+struct Published
+{
+    std::atomic<bool> running{false};
+    std::atomic<int> jobsDone{0}, jobsTotal{0};
+    std::atomic<double> elapsedSeconds{0}, etaSeconds{0}, bytesWritten{0};
+
+    double mbWritten() const { return bytesWritten / (1024.0 * 1024.0); }
+    double mbPerSecond() const { return elapsedSeconds > 0 ? mbWritten() / elapsedSeconds : 0; }
+    double jobsPerHour() const
+    {
+        return elapsedSeconds > 0 ? jobsDone * 3600.0 / elapsedSeconds : 0;
+    }
+};
+} // namespace baconpaul::samplecreator::progress
+#endif // SAMPLECREATOR_RENDERPROGRESS_HPP
@@ -0,0 +1,236 @@
+/*
+ * SampleCreator
+ *
+ * An experimental idea based on a preliminary convo. Probably best to come back later.
+ *
+ * Copyright Paul Walker 2024
+ *
+ * Released under the MIT License. See `LICENSE.md` for details
+ */
+
+#ifndef SRC_REWRAP_HPP
+#define SRC_REWRAP_HPP
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <map>
+#include <optional>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+#include "RenderJob.hpp"
+#include "RIFFWavReader.hpp"
+#include "Manifest.hpp"
+
+namespace baconpaul::samplecreator::rewrap
+{
+/*
+ * "Just the wrapper". Rather than re-record, rebuild the list of takes from the wav files
+ * an earlier render left behind. The key and velocity ranges come from the inst chunk
+ * the RIFFWavWriter adds; the round robins are the takes which share a zone, ordered by the
+ * rr_N in their name.
+ *
+ * Parsing headers is all small reads across many files, so we spread it over threads.
+ */
+inline std::vector<fs::path> findWavFiles(const fs::path &wavDir)
+{
+    std::vector<fs::path> res;
+    try
+    {
+        for (const auto &e : fs::recursive_directory_iterator(wavDir))
+        {
+            if (!e.is_regular_file())
+                continue;
+            auto ext = e.path().extension().u8string();
+            std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+            if (ext == ".wav")
+                res.push_back(e.path());
+        }
+    }
+    catch (const fs::filesystem_error &)
+    {
+    }
+    std::sort(res.begin(), res.end());
+    return res;
+}
+
+// Our file names and folders all carry "vel_N" and "rr_N", so use them when they are there
+inline int numberFromPath(const std::string &p, const std::string &key, int defVal)
+{
+    auto vp = p.rfind(key);
+    if (vp != std::string::npos && vp + key.size() < p.size() &&
+        std::isdigit((unsigned char)p[vp + key.size()]))
+    {
+        return std::atoi(p.c_str() + vp + key.size());
+    }
+    return defVal;
+}
+
+// The takes for files in wavDir, numbered as named; see numberRoundRobins
+inline std::vector<Take> scanFiles(const std::vector<fs::path> &files, const fs::path &wavDir,
+                                   std::vector<std::string> &errors,
+                                   unsigned int nThreads = std::thread::hardware_concurrency())
+{
+    std::vector<std::optional<Take>> found(files.size());
+    std::vector<std::string> errs(files.size());
+
+    auto scanRange = [&](size_t from, size_t to) {
+        for (auto i = from; i < to; ++i)
+        {
+            riffwav::RIFFWavReader rd(files[i]);
+            if (!rd.openFile())
+            {
+                errs[i] = rd.errMsg;
+                continue;
+            }
+            if (!rd.hasInst)
+            {
+                errs[i] = "'" + files[i].filename().u8string() + "' has no inst chunk; skipped";
+                continue;
+            }
+
+            Take t;
+            t.relativePath = files[i].lexically_relative(wavDir);
+            t.sampleCount = rd.getSampleCount();
+            auto &j = t.job;
+            j.midiNote = rd.keyRoot;
+            j.noteFrom = rd.keyLow;
+            j.noteTo = rd.keyHigh;
+            j.velFrom = rd.velLow;
+            j.velTo = rd.velHigh;
+            auto ps = t.relativePath.generic_u8string();
+            j.velocity = std::clamp(numberFromPath(ps, "vel_", (j.velFrom + j.velTo) / 2), 1, 127);
+            j.roundRobinIndex = numberFromPath(ps, "rr_", 0);
+            found[i] = t;
+        }
+    };
+
+    nThreads = std::clamp(nThreads, 1U, 64U);
+    auto per = (files.size() + nThreads - 1) / nThreads;
+    std::vector<std::thread> workers;
+    for (size_t s = 0; s < files.size(); s += per)
+        workers.emplace_back(scanRange, s, std::min(s + per, files.size()));
+    for (auto &w : workers)
+        w.join();
+
+    std::vector<Take> res;
+    for (size_t i = 0; i < files.size(); ++i)
+    {
+        if (found[i].has_value())
+            res.push_back(*found[i]);
+        if (!errs[i].empty())
+            errors.push_back(errs[i]);
+    }
+    return res;
+}
+
+// Takes with the same zone are the round robins of one another, in the order of their index
+inline void numberRoundRobins(std::vector<Take> &res)
+{
+    using zone_t = std::tuple<int, int, int, int, int>;
+    std::map<zone_t, std::vector<size_t>> zones;
+    for (size_t i = 0; i < res.size(); ++i)
+    {
+        const auto &j = res[i].job;
+        zones[{j.noteFrom, j.noteTo, j.midiNote, j.velFrom, j.velTo}].push_back(i);
+    }
+    for (auto &[z, idx] : zones)
+    {
+        std::stable_sort(idx.begin(), idx.end(), [&res](auto a, auto b) {
+            return res[a].job.roundRobinIndex < res[b].job.roundRobinIndex;
+        });
+        for (size_t r = 0; r < idx.size(); ++r)
+        {
+            res[idx[r]].job.roundRobinIndex = r;
+            res[idx[r]].job.roundRobinOutOf = idx.size();
+        }
+    }
+}
+
+inline std::vector<Take> scanTakes(const fs::path &wavDir, std::vector<std::string> &errors,
+                                   unsigned int nThreads = std::thread::hardware_concurrency())
+{
+    auto res = scanFiles(findWavFiles(wavDir), wavDir, errors, nThreads);
+    numberRoundRobins(res);
+    return res;
+}
+
+/*
+ * A sharded render leaves a manifest per shard, and a shard which renders again rewrites
+ * its own, so several can list the same file. Keep the record of each file written last
+ * (records from a version 1 manifest have no time, so count as oldest).
+ */
+inline std::vector<manifest::TakeRecord> latestRecords(const fs::path &sampleDir)
+{
+    std::vector<fs::path> manifests;
+    try
+    {
+        for (const auto &e : fs::directory_iterator(sampleDir))
+            if (e.is_regular_file() && manifest::isManifestFileName(e.path().filename().u8string()))
+                manifests.push_back(e.path());
+    }
+    catch (const fs::filesystem_error &)
+    {
+        return {};
+    }
+    std::sort(manifests.begin(), manifests.end());
+
+    std::map<std::string, manifest::TakeRecord> byPath;
+    for (const auto &m : manifests)
+    {
+        manifest::ManifestReader rd(m);
+        if (!rd.openFile())
+            continue;
+        for (const auto &r : rd.readAll())
+        {
+            auto it = byPath.find(r.path);
+            if (it == byPath.end() || r.writtenAt >= it->second.writtenAt)
+                byPath[r.path] = r;
+        }
+    }
+
+    std::vector<manifest::TakeRecord> res;
+    for (auto &[p, r] : byPath)
+        res.push_back(r);
+    return res;
+}
+
+/*
+ * Every take in wavDir. The manifests save opening the wavs they list, but a render starts
+ * its manifest afresh, so one stopped early lists only what it got to; we scan just the
+ * wavs no manifest lists. Listed takes no longer on disk are left out. listed is how many
+ * came from the manifests.
+ */
+inline std::vector<Take> findTakes(const fs::path &sampleDir, const fs::path &wavDir,
+                                   std::vector<std::string> &errors, size_t &listed,
+                                   unsigned int nThreads = std::thread::hardware_concurrency())
+{
+    std::map<std::string, Take> fromManifests;
+    for (const auto &r : latestRecords(sampleDir))
+    {
+        auto t = r.toTake();
+        fromManifests.emplace(t.relativePath.generic_u8string(), t);
+    }
+
+    std::vector<Take> res;
+    std::vector<fs::path> unlisted;
+    for (const auto &f : findWavFiles(wavDir))
+    {
+        auto m = fromManifests.find(f.lexically_relative(wavDir).generic_u8string());
+        if (m != fromManifests.end())
+            res.push_back(m->second);
+        else
+            unlisted.push_back(f);
+    }
+    listed = res.size();
+
+    for (const auto &t : scanFiles(unlisted, wavDir, errors, nThreads))
+        res.push_back(t);
+    numberRoundRobins(res);
+    return res;
+}
+} // namespace baconpaul::samplecreator::rewrap
+#endif // SAMPLECREATOR_REWRAP_HPP
@@ -0,0 +1,415 @@
+/*
+ * SampleCreator
+ *
+ * An experimental idea based on a preliminary convo. Probably best to come back later.
+ *
+ * Copyright Paul Walker 2024
+ *
+ * Released under the MIT License. See `LICENSE.md` for details
+ */
+
+#ifndef SRC_SF2WRITER_HPP
+#define SRC_SF2WRITER_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include "RenderJob.hpp"
+#include "RIFFWavReader.hpp"
+
+namespace baconpaul::samplecreator::sf2
+{
+/*
+ * Packs a set of takes into a single SoundFont 2 bank with one preset and one instrument.
+ * Each take becomes a zone (two zones, panned hard left and right, for a stereo take) with
+ * the key and velocity range from its render job.
+ *
+ * The sample data is streamed from the wav files a block at a time. For 24 bit output
+ * the low bytes live in a separate sm24 chunk after the smpl chunk, so we simply make a
+ * second pass over the wav files for that.
+ *
+ * SF2 has no concept of round robin, so only the first round robin is packed.
+ */
+struct SF2Writer
+{
+    fs::path outPath{};
+    FILE *outf{nullptr};
+    std::string errMsg{};
+
+    bool twentyFourBit{true};
+
+    SF2Writer(const fs::path &p, bool tfb) : outPath(p), twentyFourBit(tfb) {}
+    ~SF2Writer()
+    {
+        if (outf)
+            std::fclose(outf);
+    }
+
+    static constexpr size_t zeroPadPoints{46}; // the spec requires 46 zero points per sample
+
+    struct SampleHeader
+    {
+        fs::path source{};
+        int channel{0}, nChannels{1};
+        uint32_t start{0}, end{0};
+        uint32_t sampleRate{48000};
+        int rootKey{60};
+        int link{0};
+        uint16_t sampleType{1}; // 1 mono, 2 right, 4 left
+        RenderJob job;
+    };
+    std::vector<SampleHeader> headers;
+
+    void pushc4(const char *c) { std::fwrite(c, 1, 4, outf); }
+    void pushi32(uint32_t i) { std::fwrite(&i, 1, 4, outf); }
+    void pushi16(uint16_t i) { std::fwrite(&i, 1, 2, outf); }
+    void pushi8(uint8_t i) { std::fwrite(&i, 1, 1, outf); }
+    // zero terminated and padded to an even length, as the INFO strings require
+    void pushZString(const std::string &s)
+    {
+        std::fwrite(s.c_str(), 1, s.size() + 1, outf);
+        if ((s.size() + 1) & 1)
+            pushi8(0);
+    }
+    void pushName(const std::string &s)
+    {
+        char nm[20];
+        memset(nm, 0, sizeof(nm));
+        strncpy(nm, s.c_str(), 19);
+        std::fwrite(nm, 1, 20, outf);
+    }
+
+    // Chunks are written with a placeholder size which is patched when closed
+    long startChunk(const char *id)
+    {
+        pushc4(id);
+        auto res = std::ftell(outf);
+        pushi32(0);
+        return res;
+    }
+    long startList(const char *id)
+    {
+        auto res = startChunk("LIST");
+        pushc4(id);
+        return res;
+    }
+    void endChunk(long sizePos)
+    {
+        auto here = std::ftell(outf);
+        uint32_t sz = here - sizePos - 4;
+        if (sz & 1)
+        {
+            pushi8(0);
+            here++;
+        }
+        std::fseek(outf, sizePos, SEEK_SET);
+        pushi32(sz);
+        std::fseek(outf, here, SEEK_SET);
+    }
+
+    /*
+     * The soundfont is written to a temporary file alongside and renamed into place once
+     * it is complete, so a failed write never leaves a truncated .sf2 where one was.
+     */
+    [[nodiscard]] bool write(const std::string &name, const fs::path &sampleDir,
+                             const std::vector<Take> &takes)
+    {
+        if (!scanTakes(sampleDir, takes))
+            return false;
+
+        auto tmpPath = outPath;
+        tmpPath += ".tmp";
+        outf = fopen(tmpPath.u8string().c_str(), "wb");
+        if (!outf)
+        {
+            errMsg = "Unable to open '" + tmpPath.u8string() + "' for writing";
+            return false;
+        }
+
+        auto ok = writeBody(name);
+        if (ok && std::ferror(outf))
+        {
+            errMsg = "Error writing '" + tmpPath.u8string() + "'";
+            ok = false;
+        }
+        std::fclose(outf);
+        outf = nullptr;
+
+        std::error_code ec;
+        if (ok)
+        {
+            fs::rename(tmpPath, outPath, ec);
+            if (ec)
+            {
+                errMsg = "Unable to move '" + tmpPath.u8string() + "' into place : " +
+                         ec.message();
+                ok = false;
+            }
+        }
+        if (!ok)
+            fs::remove(tmpPath, ec);
+        return ok;
+    }
+
+    bool writeBody(const std::string &name)
+    {
+        auto riff = startChunk("RIFF");
+        pushc4("sfbk");
+
+        auto info = startList("INFO");
+        auto c = startChunk("ifil");
+        pushi16(2);
+        pushi16(twentyFourBit ? 4 : 1);
+        endChunk(c);
+        c = startChunk("isng");
+        pushZString("EMU8000");
+        endChunk(c);
+        c = startChunk("INAM");
+        pushZString(name);
+        endChunk(c);
+        c = startChunk("ISFT");
+        pushZString("Rack SampleCreator");
+        endChunk(c);
+        endChunk(info);
+
+        auto sdta = startList("sdta");
+        c = startChunk("smpl");
+        if (!streamSampleData(false))
+            return false;
+        endChunk(c);
+        if (twentyFourBit)
+        {
+            c = startChunk("sm24");
+            if (!streamSampleData(true))
+                return false;
+            endChunk(c);
+        }
+        endChunk(sdta);
+
+        writePresetData(name);
+        endChunk(riff);
+        return true;
+    }
+
+    bool scanTakes(const fs::path &sampleDir, const std::vector<Take> &takes)
+    {
+        headers.clear();
+        uint32_t pos{0};
+        for (const auto &t : takes)
+        {
+            if (t.job.roundRobinIndex != 0)
+                continue;
+
+            riffwav::RIFFWavReader rd(sampleDir / t.relativePath);
+            if (!rd.openFile())
+            {
+                errMsg = rd.errMsg;
+                return false;
+            }
+
+            auto nc = std::min((int)rd.nChannels, 2);
+            auto first = headers.size();
+            for (int ch = 0; ch < nc; ++ch)
+            {
+                SampleHeader h;
+                h.source = sampleDir / t.relativePath;
+                h.channel = ch;
+                h.nChannels = rd.nChannels;
+                h.start = pos;
+                h.end = pos + rd.getSampleCount();
+                h.sampleRate = rd.sampleRate;
+                h.rootKey = t.job.midiNote;
+                h.job = t.job;
+                if (nc == 2)
+                {
+                    h.sampleType = ch == 0 ? 4 : 2;
+                    h.link = first + 1 - ch;
+                }
+                headers.push_back(h);
+                pos = h.end + zeroPadPoints;
+            }
+        }
+        if (headers.empty())
+        {
+            errMsg = "No samples to write to SF2";
+            return false;
+        }
+        return true;
+    }
+
+    /*
+     * Write either the upper 16 bits (into smpl) or the lower 8 bits (into sm24) of
+     * every sample, reading each wav a block at a time
+     */
+    bool streamSampleData(bool lowBytes)
+    {
+        static constexpr size_t blockFrames{4096};
+        std::vector<float> in(blockFrames * 2);
+        std::vector<int16_t> hi(blockFrames);
+        std::vector<uint8_t> lo(blockFrames);
+
+        for (const auto &h : headers)
+        {
+            riffwav::RIFFWavReader rd(h.source);
+            if (!rd.openFile())
+            {
+                errMsg = rd.errMsg;
+                return false;
+            }
+            in.resize(blockFrames * rd.nChannels);
+
+            size_t got;
+            while ((got = rd.readInterleavedBlock(in.data(), blockFrames)) > 0)
+            {
+                for (size_t i = 0; i < got; ++i)
+                {
+                    auto f = std::clamp(in[i * rd.nChannels + h.channel], -1.f, 1.f);
+                    if (twentyFourBit)
+                    {
+                        auto v = (int32_t)std::clamp(std::lround(f * 8388607.f), -8388608L,
+                                                     8388607L);
+                        hi[i] = (int16_t)(v >> 8);
+                        lo[i] = (uint8_t)(v & 0xFF);
+                    }
+                    else
+                    {
+                        hi[i] = (int16_t)std::clamp(std::lround(f * 32767.f), -32768L, 32767L);
+                    }
+                }
+                if (lowBytes)
+                    std::fwrite(lo.data(), 1, got, outf);
+                else
+                    std::fwrite(hi.data(), 2, got, outf);
+            }
+
+            for (size_t i = 0; i < zeroPadPoints; ++i)
+            {
+                if (lowBytes)
+                    pushi8(0);
+                else
+                    pushi16(0);
+            }
+        }
+        return true;
+    }
+
+    void writePresetData(const std::string &name)
+    {
+        auto pdta = startList("pdta");
+
+        // One preset, with one zone pointing at instrument 0
+        auto c = startChunk("phdr");
+        for (int i = 0; i < 2; ++i)
+        {
+            pushName(i == 0 ? name : "EOP");
+            pushi16(0);
+            pushi16(0);
+            pushi16(i); // bag index
+            pushi32(0);
+            pushi32(0);
+            pushi32(0);
+        }
+        endChunk(c);
+
+        c = startChunk("pbag");
+        for (int i = 0; i < 2; ++i)
+        {
+            pushi16(i); // gen index
+            pushi16(0);
+        }
+        endChunk(c);
+
+        c = startChunk("pmod");
+        for (int i = 0; i < 10; ++i)
+            pushi8(0);
+        endChunk(c);
+
+        c = startChunk("pgen");
+        pushi16(41); // instrument
+        pushi16(0);
+        pushi16(0);
+        pushi16(0);
+        endChunk(c);
+
+        // One instrument with a zone per sample header
+        c = startChunk("inst");
+        pushName(name);
+        pushi16(0);
+        pushName("EOI");
+        pushi16(headers.size());
+        endChunk(c);
+
+        c = startChunk("ibag");
+        uint16_t genIdx{0};
+        for (const auto &h : headers)
+        {
+            pushi16(genIdx);
+            pushi16(0);
+            genIdx += h.sampleType == 1 ? 4 : 5;
+        }
+        pushi16(genIdx);
+        pushi16(0);
+        endChunk(c);
+
+        c = startChunk("imod");
+        for (int i = 0; i < 10; ++i)
+            pushi8(0);
+        endChunk(c);
+
+        // keyRange and velRange must be first and sampleID last in each zone
+        c = startChunk("igen");
+        int idx{0};
+        for (const auto &h : headers)
+        {
+            pushi16(43); // keyRange
+            pushi8(h.job.noteFrom);
+            pushi8(h.job.noteTo);
+            pushi16(44); // velRange
+            pushi8(h.job.velFrom);
+            pushi8(h.job.velTo);
+            if (h.sampleType != 1)
+            {
+                pushi16(17); // pan, in 0.1%
+                pushi16((uint16_t)(h.sampleType == 4 ? -500 : 500));
+            }
+            pushi16(58); // overridingRootKey
+            pushi16(h.rootKey);
+            pushi16(53); // sampleID
+            pushi16(idx);
+            idx++;
+        }
+        pushi16(0);
+        pushi16(0);
+        endChunk(c);
+
+        c = startChunk("shdr");
+        for (const auto &h : headers)
+        {
+            pushName("n" + std::to_string(h.job.midiNote) + "v" + std::to_string(h.job.velocity) +
+                     (h.sampleType == 4 ? "L" : (h.sampleType == 2 ? "R" : "")));
+            pushi32(h.start);
+            pushi32(h.end);
+            pushi32(h.start);
+            pushi32(h.end);
+            pushi32(h.sampleRate);
+            pushi8(h.rootKey);
+            pushi8(0);
+            pushi16(h.link);
+            pushi16(h.sampleType);
+        }
+        pushName("EOS");
+        for (int i = 0; i < 26; ++i)
+            pushi8(0);
+        endChunk(c);
+
+        endChunk(pdta);
+    }
+};
+} // namespace baconpaul::samplecreator::sf2
+#endif // SAMPLECREATOR_SF2WRITER_HPP
@@ -193,9 +193,29 @@ struct SampleCreatorStatusWidget : rack::Widget, SampleCreatorSkin::Client
         nvgFontSize(vg, 18);
 
         nvgText(vg, 2, 21, status[1].c_str(), nullptr);
+
+        // the plan estimate, right aligned in a smaller font
+        nvgFontSize(vg, 12);
+        nvgTextAlign(vg, NVG_ALIGN_RIGHT | NVG_ALIGN_TOP);
+        for (int i = 0; i < 2; ++i)
+        {
+            nvgBeginPath(vg);
+            nvgFillColor(vg, sampleCreatorSkin.logText());
+            nvgText(vg, box.size.x - 3, 5 + 19 * i, estimate[i].c_str(), nullptr);
+        }
     }
 
     std::string status[2];
+    std::string estimate[2];
+    void setEstimate(const std::string &a, const std::string &b)
+    {
+        if (a == estimate[0] && b == estimate[1])
+            return;
+        estimate[0] = a;
+        estimate[1] = b;
+        bdwLayer->dirty = true;
+    }
+
     void step() override
     {
         if (module)
@@ -336,17 +356,19 @@ struct SampleCreatorJobsKeyboard : rack::Widget, SampleCreatorSkin::Client
         return res;
     }
 
-    std::vector<SampleCreatorModule::RenderJob> jobs;
+    // The plan we draw; we keep the snapshot rather than copying its table
+    PlanPtr plan{std::make_shared<PlanSnapshot>()};
     int sn{0}, en{127};
-    void pushNewJobSet(const std::vector<SampleCreatorModule::RenderJob> &j)
+    void pushNewJobSet(PlanPtr p)
     {
-        jobs = j;
+        plan = std::move(p);
+        const auto &jobs = plan->jobs;
         sn = 127;
         en = 0;
-        for (auto j : jobs)
+        for (size_t i = 0; i < jobs.size(); ++i)
         {
-            sn = std::min(j.noteFrom, sn);
-            en = std::max(j.noteTo, en);
+            sn = std::min((int)jobs.noteFrom[i], sn);
+            en = std::max((int)jobs.noteTo[i], en);
         }
         // round to octave
         sn = (sn / 12) * 12;
@@ -429,11 +451,13 @@ struct SampleCreatorJobsKeyboard : rack::Widget, SampleCreatorSkin::Client
 
         auto idx = 0;
         auto cji = -1;
+        SampleCreatorModule::jobSelection_t sel;
         if (module)
         {
             cji = module->currentJobIndex;
+            sel = module->currentJobSelection();
         }
-        for (auto j : jobs)
+        for (auto j : plan->jobs)
         {
             auto mn = (j.midiNote - sn) * mks;
             auto ve = (127 - j.velocity) * vls;
@@ -443,7 +467,7 @@ struct SampleCreatorJobsKeyboard : rack::Widget, SampleCreatorSkin::Client
             auto ys = (127 - j.velTo) * vls;
             auto ye = (127 - j.velFrom) * vls;
 
-            if (idx == cji || j.roundRobinIndex != 0)
+            if (idx == cji || j.roundRobinIndex != 0 || (module && module->isVoiceJob(idx)))
             {
                 // paint in the glow layer
             }
@@ -465,6 +489,16 @@ struct SampleCreatorJobsKeyboard : rack::Widget, SampleCreatorSkin::Client
                 nvgFill(vg);
                 nvgStroke(vg);
             }
+            if (sel && j.roundRobinIndex == 0 && sel->matches(j))
+            {
+                // marked for re-render
+                nvgBeginPath(vg);
+                nvgStrokeColor(vg, nvgRGB(255, 150, 40));
+                nvgStrokeWidth(vg, 1.5);
+                nvgRect(vg, xs + 1, ys + 1, xe - xs - 2, ye - ys - 2);
+                nvgStroke(vg);
+                nvgStrokeWidth(vg, 1.0);
+            }
             idx++;
         }
     }
@@ -480,7 +514,7 @@ struct SampleCreatorJobsKeyboard : rack::Widget, SampleCreatorSkin::Client
         {
             cji = module->currentJobIndex;
         }
-        for (auto j : jobs)
+        for (auto j : plan->jobs)
         {
             auto mn = (j.midiNote - sn) * mks;
             auto ve = (127 - j.velocity) * vls;
@@ -490,7 +524,7 @@ struct SampleCreatorJobsKeyboard : rack::Widget, SampleCreatorSkin::Client
             auto ys = (127 - j.velTo) * vls;
             auto ye = (127 - j.velFrom) * vls;
 
-            if (idx == cji)
+            if (idx == cji || (module && module->isVoiceJob(idx)))
             {
                 nvgStrokeColor(vg, nvgRGB(220, 220, 255));
                 nvgFillColor(vg, nvgRGBA(220, 220, 255, 200));
@@ -510,20 +544,59 @@ struct SampleCreatorJobsKeyboard : rack::Widget, SampleCreatorSkin::Client
     }
 
     int currentIndexCache{-1};
+    int activeVoiceCache{0};
+    int selectionVersionCache{-1};
+    uint64_t planVersionCache{0};
 
     void step() override
     {
         if (module)
         {
-            if (currentIndexCache != module->currentJobIndex)
+            auto latest = module->shownPlan();
+            if (latest->version != planVersionCache)
+            {
+                pushNewJobSet(latest);
+                planVersionCache = latest->version;
+            }
+            auto avc = module->activeVoiceCount();
+            if (currentIndexCache != module->currentJobIndex || activeVoiceCache != avc ||
+                selectionVersionCache != module->jobSelectionVersion)
             {
                 repaint();
             }
             currentIndexCache = module->currentJobIndex;
+            activeVoiceCache = avc;
+            selectionVersionCache = module->jobSelectionVersion;
         }
         rack::Widget::step();
     }
 
+    // Clicking a note in the plan marks (or unmarks) all of its jobs for re-render
+    void onButton(const ButtonEvent &e) override
+    {
+        if (module && e.action == GLFW_PRESS && e.button == GLFW_MOUSE_BUTTON_LEFT &&
+            module->createState == SampleCreatorModule::INACTIVE && en > sn)
+        {
+            // a click anywhere in a note's key range toggles the note sampled for it
+            auto key = sn + (int)std::floor(e.pos.x / (box.size.x / (en - sn)));
+            const auto &jobs = plan->jobs;
+            for (size_t i = 0; i < jobs.size(); ++i)
+            {
+                if (jobs.noteFrom[i] <= key && key <= jobs.noteTo[i])
+                {
+                    int note = jobs.midiNote[i];
+                    module->editJobSelection([note](auto &sel) {
+                        sel.toggleNote(note);
+                        return true;
+                    });
+                    e.consume(this);
+                    return;
+                }
+            }
+        }
+        rack::Widget::onButton(e);
+    }
+
     void repaint()
     {
         if (bdw)
@@ -844,11 +917,8 @@ struct SampleCreatorModuleWidget : rack::ModuleWidget, SampleCreatorSkin::Client
             add(
                 "Test",
                 [m]() {
-                    if (m && m->createState == SampleCreatorModule::INACTIVE)
-                    {
-                        m->testMode = true;
-                        m->startOperating = true;
-                    }
+                    if (m)
+                        m->requestStart(true);
                 },
                 [m]() {
                     if (m)
@@ -860,11 +930,8 @@ struct SampleCreatorModuleWidget : rack::ModuleWidget, SampleCreatorSkin::Client
             add(
                 "Start",
                 [m]() {
-                    if (m && m->createState == SampleCreatorModule::INACTIVE)
-                    {
-                        m->testMode = false;
-                        m->startOperating = true;
-                    }
+                    if (m)
+                        m->requestStart(false);
                 },
                 [m]() {
                     if (m)
@@ -889,7 +956,8 @@ struct SampleCreatorModuleWidget : rack::ModuleWidget, SampleCreatorSkin::Client
             rg.size.x = statusRegion.size.x - rg.pos.x + margin;
             rg = rg.shrink({margin, margin});
 
-            addChild(SampleCreatorStatusWidget::create(rg.pos, rg.size, m));
+            statusWidget = SampleCreatorStatusWidget::create(rg.pos, rg.size, m);
+            addChild(statusWidget);
         }
 
         {
@@ -956,7 +1024,233 @@ struct SampleCreatorModuleWidget : rack::ModuleWidget, SampleCreatorSkin::Client
         }
     }
 
-    void appendContextMenu(rack::Menu *menu) override {}
+    // Restrict the render to a job list (see JobSelection.hpp) read from a text file
+    static void loadJobList(SampleCreatorModule *scm)
+    {
+        char *path = osdialog_file(OSDIALOG_OPEN, scm->currentSampleDir.u8string().c_str(), "",
+                                   NULL);
+        if (!path)
+            return;
+        auto fn = fs::path{path};
+        free(path);
+
+        std::ifstream in(fn);
+        if (!in.is_open())
+        {
+            scm->pushError("Unable to open job list '" + fn.u8string() + "'");
+            return;
+        }
+        std::stringstream ss;
+        ss << in.rdbuf();
+        auto text = ss.str();
+        if (!scm->editJobSelection([&text](auto &sel) { return sel.parse(text); }))
+        {
+            scm->pushError(scm->jobSelectionError);
+            return;
+        }
+        scm->pushMessage("Loaded " + std::to_string(scm->currentJobSelection()->rules.size()) +
+                         " job list rules from '" + fn.filename().u8string() + "'");
+    }
+
+    // A submenu choosing one of a few values for a float setting, checking the current one
+    static void addValueSubmenu(rack::Menu *menu, const std::string &label,
+                                const std::vector<float> &values, const std::string &unit,
+                                float &onto, const std::string &zeroLabel = "")
+    {
+        menu->addChild(rack::createSubmenuItem(
+            label, "", [values, unit, &onto, zeroLabel](rack::Menu *sm) {
+                for (auto v : values)
+                {
+                    auto lab = (v == 0 && !zeroLabel.empty()) ? zeroLabel
+                                                              : rack::string::f("%g", v) + unit;
+                    sm->addChild(rack::createCheckMenuItem(
+                        lab, "", [&onto, v]() { return onto == v; }, [&onto, v]() { onto = v; }));
+                }
+            }));
+    }
+
+    // Choose one of the preset curves; a curve from the patch which isn't one shows as custom
+    static void addCurveSubmenu(rack::Menu *menu, const std::string &label,
+                                const std::vector<curve::Preset> &presets,
+                                SampleCreatorModule::curvePtr_t &onto)
+    {
+        auto cur = std::atomic_load(&onto);
+        auto it = std::find_if(presets.begin(), presets.end(),
+                               [&cur](const auto &p) { return p.curve == *cur; });
+        auto current = it == presets.end() ? std::string("Custom") : it->name;
+        menu->addChild(
+            rack::createSubmenuItem(label, current, [&presets, &onto](rack::Menu *sm) {
+                for (const auto &p : presets)
+                {
+                    sm->addChild(rack::createCheckMenuItem(
+                        p.name, "", [&onto, &p]() { return *std::atomic_load(&onto) == p.curve; },
+                        [&onto, &p]() { SampleCreatorModule::setCurve(onto, p.curve); }));
+                }
+            }));
+    }
+
+    void appendContextMenu(rack::Menu *menu) override
+    {
+        auto scm = dynamic_cast<SampleCreatorModule *>(module);
+        if (!scm)
+            return;
+
+        menu->addChild(new rack::ui::MenuSeparator);
+        menu->addChild(rack::createMenuItem(
+            "Rewrap Existing Samples", "",
+            [scm]() {
+                if (scm->createState == SampleCreatorModule::INACTIVE)
+                    scm->rewrapRequested = true;
+            },
+            scm->createState != SampleCreatorModule::INACTIVE || scm->rewrapRequested));
+        // a render keeps the layout, shards and SF2 depth it started with
+        auto rendering = scm->createState != SampleCreatorModule::INACTIVE;
+        menu->addChild(rack::createIndexSubmenuItem(
+            "SF2 Bit Depth", {"16 bit", "24 bit"},
+            [scm]() { return scm->sf2TwentyFourBit ? 1 : 0; },
+            [scm](size_t i) { scm->sf2TwentyFourBit = (i == 1); }, rendering));
+        menu->addChild(rack::createIndexSubmenuItem(
+            "Sample Folder Layout", {"Flat", "Note / Velocity Folders", "Hashed Folders"},
+            [scm]() { return (size_t)scm->sampleLayout; },
+            [scm](size_t i) { scm->sampleLayout = (SampleCreatorModule::SampleLayout)i; },
+            rendering));
+        menu->addChild(rack::createIndexSubmenuItem(
+            "Voice Scheduling", {"Lockstep", "Overlapped"},
+            [scm]() { return (size_t)scm->scheduling; },
+            [scm](size_t i) { scm->scheduling = (SampleCreatorModule::Scheduling)i; }));
+        menu->addChild(rack::createIndexSubmenuItem(
+            "Max Overlapping Voices",
+            {"Polyphony", "1", "2", "3", "4", "5", "6", "7", "8", "9", "10", "11", "12", "13",
+             "14", "15", "16"},
+            [scm]() { return (size_t)scm->maxOverlap; },
+            [scm](size_t i) { scm->maxOverlap = (int)i; }));
+        menu->addChild(rack::createIndexSubmenuItem(
+            "Job Order", {"In Order", "Spread Pitches", "Coarse To Fine"},
+            [scm]() { return (size_t)scm->jobOrdering; },
+            [scm](size_t i) { scm->jobOrdering = (SampleCreatorModule::JobOrder)i; }));
+        menu->addChild(rack::createIndexSubmenuItem(
+            "Re-record Overloaded Takes", {"Never", "Once", "Up To Twice", "Up To 3 Times"},
+            [scm]() { return (size_t)scm->overloadRetries; },
+            [scm](size_t i) { scm->overloadRetries = (int)i; }));
+        menu->addChild(new rack::ui::MenuSeparator);
+        menu->addChild(rack::createIndexSubmenuItem(
+            "Shard Mode", {"Off", "Fixed Shard", "Shared Queue"},
+            [scm]() { return (size_t)scm->shardMode; },
+            [scm](size_t i) { scm->shardMode = (SampleCreatorModule::ShardMode)i; }, rendering));
+        if (scm->shardMode == SampleCreatorModule::FIXED_SHARD)
+        {
+            std::vector<std::string> counts, indices;
+            for (int i = 2; i <= SampleCreatorModule::maxShards; ++i)
+                counts.push_back(std::to_string(i));
+            for (int i = 1; i <= scm->shardCount; ++i)
+                indices.push_back(std::to_string(i) + " of " + std::to_string(scm->shardCount));
+            menu->addChild(rack::createIndexSubmenuItem(
+                "Shard Count", counts, [scm]() { return (size_t)(scm->shardCount - 2); },
+                [scm](size_t i) {
+                    scm->shardCount = (int)i + 2;
+                    scm->shardIndex = std::min(scm->shardIndex, scm->shardCount - 1);
+                },
+                rendering));
+            menu->addChild(rack::createIndexSubmenuItem(
+                "This Shard", indices, [scm]() { return (size_t)scm->shardIndex; },
+                [scm](size_t i) { scm->shardIndex = (int)i; }, rendering));
+        }
+        if (scm->shardMode == SampleCreatorModule::QUEUE_SHARD)
+        {
+            menu->addChild(rack::createMenuItem(
+                "Clear Shard Claims", "", [scm]() { scm->clearClaimsRequested = true; },
+                rendering));
+        }
+        menu->addChild(new rack::ui::MenuSeparator);
+        menu->addChild(rack::createIndexSubmenuItem(
+            "Silence Detector", {"Peak", "RMS"},
+            [scm]() { return (size_t)scm->silenceSettings.mode; },
+            [scm](size_t i) {
+                scm->silenceSettings.mode = (silence::SilenceDetector::Mode)i;
+            }));
+        addValueSubmenu(menu, "Silence Threshold", {-60.f, -72.f, -80.f, -96.f, -120.f}, " dBFS",
+                        scm->silenceSettings.thresholdDb);
+        addValueSubmenu(menu, "Silence Hold", {25.f, 50.f, 85.f, 250.f, 500.f, 1000.f}, " ms",
+                        scm->silenceHoldMs);
+        addValueSubmenu(menu, "Maximum Tail", {0.f, 2.f, 5.f, 10.f, 30.f}, " s",
+                        scm->maxTailSeconds, "No Limit");
+        addCurveSubmenu(menu, "Gate Time Across Keys", curve::keyPresets(), scm->gateKeyCurve);
+        addCurveSubmenu(menu, "Gate Time Across Velocity", curve::velocityPresets(),
+                        scm->gateVelocityCurve);
+        addCurveSubmenu(menu, "Maximum Tail Across Keys", curve::keyPresets(), scm->tailKeyCurve);
+        addCurveSubmenu(menu, "Maximum Tail Across Velocity", curve::velocityPresets(),
+                        scm->tailVelocityCurve);
+        menu->addChild(rack::createBoolMenuItem(
+            "Adaptive Gate", "", [scm]() { return scm->adaptiveGate; },
+            [scm](bool b) { scm->adaptiveGate = b; }));
+        addValueSubmenu(menu, "Adaptive Gate Minimum", {0.1f, 0.25f, 0.5f, 1.f, 2.f}, " s",
+                        scm->adaptiveGateMinSeconds);
+        addValueSubmenu(menu, "Adaptive Gate Hold After Steady", {0.f, 0.25f, 0.5f, 1.f, 2.f},
+                        " s", scm->adaptiveGateHoldSeconds);
+        menu->addChild(rack::createBoolMenuItem(
+            "Adaptive Settle Between Notes", "", [scm]() { return scm->adaptiveSettle; },
+            [scm](bool b) { scm->adaptiveSettle = b; }));
+        menu->addChild(rack::createBoolMenuItem(
+            "Trim Leading Silence", "", [scm]() { return scm->trimLeadingSilence; },
+            [scm](bool b) { scm->trimLeadingSilence = b; }));
+        menu->addChild(rack::createMenuItem(
+            "Calibrate Latency", "",
+            [scm]() {
+                if (scm->createState == SampleCreatorModule::INACTIVE)
+                    scm->calibrateRequested = true;
+            },
+            scm->createState != SampleCreatorModule::INACTIVE));
+        menu->addChild(rack::createMenuItem(
+            "Probe Round Robins", "", [scm]() { scm->requestRoundRobinProbe(); },
+            scm->createState != SampleCreatorModule::INACTIVE || scm->probeBusy()));
+        menu->addChild(rack::createMenuItem(
+            "Probe Adaptive Key Zones", "", [scm]() { scm->requestKeyZoneProbe(); },
+            scm->createState != SampleCreatorModule::INACTIVE || scm->probeBusy()));
+        addValueSubmenu(menu, "Adaptive Key Zones Max Notes", {8.f, 12.f, 16.f, 24.f, 32.f, 48.f},
+                        " notes", scm->adaptiveKeyMaxNotes);
+        auto keyNotes = std::atomic_load(&scm->adaptiveKeyNotes);
+        menu->addChild(rack::createMenuItem(
+            "Clear Adaptive Key Zones",
+            keyNotes ? std::to_string(keyNotes->size()) + " notes" : "",
+            [scm]() { scm->clearAdaptiveKeyNotes(); },
+            !keyNotes || scm->createState != SampleCreatorModule::INACTIVE));
+        menu->addChild(rack::createMenuItem(
+            "Probe Adaptive Velocity Layers", "", [scm]() { scm->requestVelocityLayerProbe(); },
+            scm->createState != SampleCreatorModule::INACTIVE || scm->probeBusy()));
+        auto velLayers = std::atomic_load(&scm->adaptiveVelocityLayers);
+        menu->addChild(rack::createMenuItem(
+            "Clear Adaptive Velocity Layers",
+            velLayers ? std::to_string(velLayers->size()) + " layers" : "",
+            [scm]() { scm->clearAdaptiveVelocityLayers(); },
+            !velLayers || scm->createState != SampleCreatorModule::INACTIVE));
+        menu->addChild(new rack::ui::MenuSeparator);
+        addValueSubmenu(menu, "Expected Tail (for Estimates)", {0.5f, 1.f, 2.f, 4.f, 8.f},
+                        " s", scm->expectedTailSeconds);
+        addValueSubmenu(menu, "Disk Budget", {0.f, 100.f, 500.f, 1000.f, 5000.f, 20000.f},
+                        " MB", scm->budgetMB, "None");
+        addValueSubmenu(menu, "Time Budget", {0.f, 10.f, 30.f, 60.f, 240.f, 480.f}, " min",
+                        scm->budgetMinutes, "None");
+        menu->addChild(rack::createBoolMenuItem(
+            "Skip Takes Already Rendered", "", [scm]() { return scm->skipExisting; },
+            [scm](bool b) { scm->skipExisting = b; }));
+        menu->addChild(rack::createMenuItem(
+            "Load Job List...", "", [scm]() { loadJobList(scm); },
+            scm->createState != SampleCreatorModule::INACTIVE));
+        auto sel = scm->currentJobSelection();
+        menu->addChild(rack::createMenuItem(
+            "Clear Job Selection", sel->empty() ? "" : std::to_string(sel->rules.size()) + " rules",
+            [scm]() {
+                scm->editJobSelection([](auto &s) {
+                    s.rules.clear();
+                    return true;
+                });
+            },
+            sel->empty() || scm->createState != SampleCreatorModule::INACTIVE));
+        menu->addChild(rack::createMenuItem(
+            "New RR Random Seed", std::to_string(scm->rrSeed),
+            [scm]() { scm->rrSeed = rack::random::u32(); },
+            scm->createState != SampleCreatorModule::INACTIVE));
+    }
 
     int footerHeight{18};
     int keyboardYEnd{0}, controlsYEnd{0};
@@ -967,6 +1261,7 @@ struct SampleCreatorModuleWidget : rack::ModuleWidget, SampleCreatorSkin::Client
     rack::Rect inputRegion, outputRegion, rangeRegion, logRegion, statusRegion, pathRegion;
 
     SampleCreatorJobsKeyboard *jobsKeyboard{nullptr};
+    SampleCreatorStatusWidget *statusWidget{nullptr};
 
     void setupPositions()
     {
@@ -1091,41 +1386,95 @@ struct SampleCreatorModuleWidget : rack::ModuleWidget, SampleCreatorSkin::Client
 
     void onSkinChanged() override { bg->dirty = true; }
 
-    float cacheParamVals[M::NUM_PARAMS]{-100000}; // make midi start note bad so the step fires
+    // The plan parameters we last asked for a preview of. The keyboard picks the plan up
+    // by its version once the module's plan worker has built it.
+    std::optional<M::PlanParameters> requestedPlan;
     void step() override
     {
-        if (module)
+        auto scm = dynamic_cast<SampleCreatorModule *>(module);
+        if (scm)
         {
-            bool paramChanged = false;
-            for (const auto &invals :
-                 {M::MIDI_START_RANGE, M::MIDI_END_RANGE, M::MIDI_STEP_SIZE, M::NUM_VEL_LAYERS,
-                  M::NUM_ROUND_ROBINS, M::VELOCITY_STRATEGY})
+            auto pp = scm->planParametersFromParams();
+            if (!requestedPlan.has_value() || *requestedPlan != pp)
             {
-                if (cacheParamVals[invals] != module->getParamQuantity(invals)->getValue())
-                {
-                    paramChanged = true;
-                    cacheParamVals[invals] = module->getParamQuantity(invals)->getValue();
-                }
+                scm->requestPreviewPlan(pp);
+                requestedPlan = pp;
             }
+        }
 
-            if (paramChanged && jobsKeyboard)
+        updateEstimate();
+
+        sampleCreatorSkin.step();
+        rack::ModuleWidget::step();
+    }
+
+    /*
+     * Re-estimate whenever anything the estimate depends on changes. The inputs are cheap to
+     * gather so we compare them each frame and only ask for an estimate when they differ;
+     * the module builds it off the UI thread and we show each result as it lands.
+     */
+    std::vector<float> estimateInputs;
+    std::shared_ptr<const M::EstimateResult> shownEstimate;
+    void updateEstimate()
+    {
+        auto scm = dynamic_cast<SampleCreatorModule *>(module);
+        if (!scm || !statusWidget)
+            return;
+
+        if (scm->createState != SampleCreatorModule::INACTIVE)
+        {
+            estimateInputs.clear();
+            shownEstimate.reset();
+            const auto &pp = scm->progressPublished;
+            if (!pp.running || pp.jobsDone == 0)
             {
-                std::vector<SampleCreatorModule::RenderJob> jobs;
-                auto scm = dynamic_cast<SampleCreatorModule *>(module);
-                assert(scm);
-                if (scm)
-                {
-                    scm->populateRenderJobs(jobs);
-                    for (auto j : jobs)
-                    {
-                        jobsKeyboard->pushNewJobSet(jobs);
-                    }
-                }
+                statusWidget->setEstimate("", "");
+                return;
+            }
+            statusWidget->setEstimate(
+                "ETA " + estimate::formatDuration(pp.etaSeconds) + "  " +
+                    std::to_string(pp.jobsDone) + "/" + std::to_string(pp.jobsTotal),
+                rack::string::f("%.0f MB  %.1f MB/s  %.0f jobs/h", pp.mbWritten(),
+                                pp.mbPerSecond(), pp.jobsPerHour()));
+            return;
+        }
+
+        std::vector<float> ins;
+        for (int i = 0; i < M::NUM_PARAMS; ++i)
+            ins.push_back(scm->getParam(i).getValue());
+        for (auto f : {scm->engineSampleRate, scm->expectedTailSeconds, scm->budgetMB,
+                       scm->budgetMinutes, scm->maxTailSeconds})
+            ins.push_back(f);
+        for (auto i : {(int)scm->scheduling, scm->maxOverlap, (int)scm->adaptiveSettle,
+                       (int)scm->sf2TwentyFourBit, (int)scm->inputs[M::INPUT_R].isConnected(),
+                       (int)scm->jobSelectionVersion})
+            ins.push_back(i);
+        for (const auto *ap : {&scm->adaptiveKeyNotes, &scm->adaptiveVelocityLayers})
+        {
+            ins.push_back(-1); // keeps the two lists apart
+            if (auto pts = std::atomic_load(ap))
+                for (auto n : *pts)
+                    ins.push_back(n);
+        }
+        for (const auto *c : {&scm->gateKeyCurve, &scm->gateVelocityCurve, &scm->tailKeyCurve,
+                              &scm->tailVelocityCurve})
+            for (const auto &[x, y] : std::atomic_load(c)->points)
+            {
+                ins.push_back(x);
+                ins.push_back(y);
             }
+        if (ins != estimateInputs)
+        {
+            estimateInputs = ins;
+            scm->requestEstimate();
         }
 
-        sampleCreatorSkin.step();
-        rack::ModuleWidget::step();
+        auto res = std::atomic_load(&scm->estimateResult);
+        if (res && res != shownEstimate)
+        {
+            shownEstimate = res;
+            statusWidget->setEstimate(res->line, res->budget);
+        }
     }
 };
 } // namespace baconpaul::samplecreator
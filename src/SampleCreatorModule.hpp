@@ -18,6 +18,8 @@
 #include <cstdint>
 #include <cstdio>
 #include <deque>
+#include <map>
+#include <set>
 #include <random>
 #include <chrono>
 #include <thread>
@@ -33,8 +35,25 @@ namespace fs = ghc::filesystem;
 #include <sst/rackhelpers/json.h>
 #include <sst/rackhelpers/neighbor_connectable.h>
 
+#include "RenderJob.hpp"
+#include "JobTable.hpp"
+#include "PlanSnapshot.hpp"
+#include "PlanWorker.hpp"
+#include "Probe.hpp"
 #include "RIFFWavWriter.hpp"
 #include "ZIPFileWriter.hpp"
+#include "MultiFileWriter.hpp"
+#include "SF2Writer.hpp"
+#include "Rewrap.hpp"
+#include "Manifest.hpp"
+#include "SilenceDetector.hpp"
+#include "SteadyStateDetector.hpp"
+#include "Curve.hpp"
+#include "PlanEstimator.hpp"
+#include "RenderProgress.hpp"
+#include "Progressive.hpp"
+#include "OverloadMonitor.hpp"
+#include "JobSelection.hpp"
 
 namespace baconpaul::samplecreator
 {
@@ -146,8 +165,17 @@ struct SampleCreatorModule : virtual rack::Module,
         JUST_WAV,
         SFZ,
         MULTISAMPLE,
-        DECENT // few places below we assume DECENT is end, configParam and setting in startRender
+        DECENT,
+        SF2 // few places below we assume SF2 is end, configParam and setting in startRender
     } multiFormat{SFZ};
+    bool sf2TwentyFourBit{true};
+
+    enum SampleLayout
+    {
+        FLAT_LAYOUT,
+        NOTE_VELOCITY_LAYOUT,
+        HASHED_LAYOUT
+    } sampleLayout{FLAT_LAYOUT};
 
     enum ReleaseMode
     {
@@ -183,12 +211,12 @@ struct SampleCreatorModule : virtual rack::Module,
         q->snapEnabled = true;
 
         {
-            auto q = configParam(NUM_VEL_LAYERS, 1, 8, 1, "Velocity Layers");
+            auto q = configParam(NUM_VEL_LAYERS, 1, maxVelocityLayers, 1, "Velocity Layers");
             q->snapEnabled = true;
         }
 
         {
-            auto q = configParam(NUM_ROUND_ROBINS, 1, 16, 1, "Round Robins");
+            auto q = configParam(NUM_ROUND_ROBINS, 1, maxRoundRobins, 1, "Round Robins");
             q->snapEnabled = true;
         }
 
@@ -203,8 +231,13 @@ struct SampleCreatorModule : virtual rack::Module,
         configSwitch(VELOCITY_STRATEGY, 0, 2, 1, "Velocity Strategy",
                      {"Uniform", "Sqrt", "Square"});
 
-        configSwitch(OUTPUT_FORMAT, JUST_WAV, DECENT, SFZ, "Output Format",
-                     {"Just WAV", "SFZ", "MultiSample", "Decent"});
+        configSwitch(OUTPUT_FORMAT, JUST_WAV, SF2, SFZ, "Output Format",
+                     {"Just WAV", "SFZ", "MultiSample", "Decent", "SF2"});
+
+        for (auto &v : voiceJobIndex)
+            v = -1;
+
+        instanceId = rack::random::u32();
 
         renderThread = std::make_unique<std::thread>([this]() { renderThreadProcess(); });
 
@@ -216,10 +249,112 @@ struct SampleCreatorModule : virtual rack::Module,
     {
         keepRunning = false;
         renderThread->join();
+        planWorker.stop();
+        estimateWorker.stop();
+    }
+
+    /*
+     * The RR random voltages come from an engine seeded per job from rrSeed and the job's
+     * note, velocity and round robin. So the same settings always give the same voltages,
+     * and adding notes to a map leaves the voltages (and fingerprints) of the others alone.
+     * The engine is local to each plan build, so the UI and audio threads can both plan.
+     */
+    uint32_t rrSeed{8675309};
+    static std::default_random_engine engineForJob(const RenderJob &j, uint32_t seed)
+    {
+        std::seed_seq sq{seed, (uint32_t)j.midiNote, (uint32_t)j.velocity,
+                         (uint32_t)j.roundRobinIndex};
+        return std::default_random_engine(sq);
+    }
+
+    /*
+     * Skip any job whose wav is already on disk, completely written, with a matching
+     * fingerprint. The render thread checks the files when the render starts and the audio
+     * thread waits for it before playing the first note.
+     */
+    bool skipExisting{true};
+    RenderSettings renderSettings;
+    std::vector<uint8_t> jobSkipped; // 1 if on disk, 2 another shard's, 3 not selected
+    std::atomic<bool> existingScanComplete{false};
+
+    /*
+     * With a job selection only the selected jobs render, whether or not they are on disk,
+     * and the takes already on disk for the rest are kept in the manifest and multi-file.
+     * The UI thread edits a copy and publishes it whole, so the audio thread reading it as a
+     * render starts never sees the rules change underneath it; the version tells the
+     * keyboard to repaint.
+     */
+    using jobSelection_t = std::shared_ptr<const selection::JobSelection>;
+    jobSelection_t jobSelection{std::make_shared<const selection::JobSelection>()};
+    std::atomic<int> jobSelectionVersion{0};
+    bool renderingSelection{false};
+
+    jobSelection_t currentJobSelection() const { return std::atomic_load(&jobSelection); }
+
+    // UI thread only. Applies f to a copy and publishes it if f returns true; false otherwise
+    template <typename F> bool editJobSelection(F f)
+    {
+        auto next = std::make_shared<selection::JobSelection>(*currentJobSelection());
+        if (!f(*next))
+        {
+            jobSelectionError = next->errMsg;
+            return false;
+        }
+        std::atomic_store(&jobSelection, jobSelection_t(next));
+        jobSelectionVersion++;
+        return true;
+    }
+    std::string jobSelectionError;
+
+    /*
+     * Sharding splits one plan across several copies of the patch writing to the same
+     * directory. A fixed shard k of n renders every job whose index is k mod n. A shared
+     * queue lets each instance claim jobs as it goes by creating a directory per job in
+     * claims/ (directory creation is atomic, even on most network drives), so a faster
+     * machine takes more of the work. Each shard writes its own manifest and whichever
+     * finishes last writes a multi-file over every shard's takes.
+     */
+    enum ShardMode
+    {
+        NO_SHARDS,
+        FIXED_SHARD,
+        QUEUE_SHARD
+    } shardMode{NO_SHARDS};
+    static constexpr int maxShards{16};
+    int shardCount{2};
+    int shardIndex{0};
+    std::atomic<uint32_t> instanceId{0}; // saved; the render thread may pick a new one
+
+    /*
+     * The folder layout, shards and SF2 depth a render (or rewrap) writes with, copied as
+     * it starts so a menu change can't split one library across two layouts or shards.
+     */
+    struct OutputLayout
+    {
+        SampleLayout sampleLayout{FLAT_LAYOUT};
+        ShardMode shardMode{NO_SHARDS};
+        int shardCount{2}, shardIndex{0};
+        bool sf2TwentyFourBit{true};
+    } renderLayout;
+
+    OutputLayout outputLayoutFromSettings() const
+    {
+        return {sampleLayout, shardMode, shardCount, shardIndex, sf2TwentyFourBit};
     }
 
-    std::default_random_engine reng;
-    std::uniform_real_distribution<float> uniReal{0.f, 1.f};
+    enum ClaimState : uint8_t
+    {
+        CLAIM_PENDING,
+        CLAIM_MINE,
+        CLAIM_ELSEWHERE
+    };
+    std::unique_ptr<std::atomic<uint8_t>[]> jobClaims;
+    std::atomic<int64_t> jobsStarted{0}; // nextJobIndex, for the render thread to claim ahead
+    std::atomic<bool> claimingActive{false};
+    bool queueSharding{false};
+    int64_t claimPosition{0}; // only used on the render thread
+    int claimedElsewhere{0};
+    std::atomic<bool> clearClaimsRequested{false};
 
     // tis is not entirely thread safe and strings can allocate but
     // it is infrequenty used. Good enough for now.
@@ -286,6 +421,76 @@ struct SampleCreatorModule : virtual rack::Module,
         auto res = json_object();
 
         json_object_set_new(res, "path", json_string(currentSampleDir.u8string().c_str()));
+        json_object_set_new(res, "sf2TwentyFourBit", json_boolean(sf2TwentyFourBit));
+        json_object_set_new(res, "sampleLayout", json_integer(sampleLayout));
+        json_object_set_new(res, "skipExisting", json_boolean(skipExisting));
+        json_object_set_new(res, "jobSelection",
+                            json_string(currentJobSelection()->toString().c_str()));
+        json_object_set_new(res, "rrSeed", json_integer(rrSeed));
+        json_object_set_new(res, "scheduling", json_integer(scheduling));
+        json_object_set_new(res, "jobOrdering", json_integer(jobOrdering));
+        json_object_set_new(res, "maxOverlap", json_integer(maxOverlap));
+        json_object_set_new(res, "overloadRetries", json_integer(overloadRetries));
+        json_object_set_new(res, "shardMode", json_integer(shardMode));
+        json_object_set_new(res, "shardCount", json_integer(shardCount));
+        json_object_set_new(res, "shardIndex", json_integer(shardIndex));
+        char idHex[16];
+        snprintf(idHex, sizeof(idHex), "%08x", instanceId.load());
+        json_object_set_new(res, "instanceId", json_string(idHex));
+        json_object_set_new(res, "silenceMode", json_integer(silenceSettings.mode));
+        json_object_set_new(res, "silenceThresholdDb", json_real(silenceSettings.thresholdDb));
+        json_object_set_new(res, "silenceHoldMs", json_real(silenceHoldMs));
+        json_object_set_new(res, "maxTailSeconds", json_real(maxTailSeconds));
+        json_object_set_new(res, "trimLeadingSilence", json_boolean(trimLeadingSilence));
+        json_object_set_new(res, "adaptiveSettle", json_boolean(adaptiveSettle));
+        auto curveToJson = [res](const char *key, const curvePtr_t &cp) {
+            auto c = std::atomic_load(&cp);
+            auto arr = json_array();
+            for (const auto &[x, y] : c->points)
+            {
+                auto pt = json_array();
+                json_array_append_new(pt, json_real(x));
+                json_array_append_new(pt, json_real(y));
+                json_array_append_new(arr, pt);
+            }
+            json_object_set_new(res, key, arr);
+        };
+        curveToJson("gateKeyCurve", gateKeyCurve);
+        curveToJson("gateVelocityCurve", gateVelocityCurve);
+        curveToJson("tailKeyCurve", tailKeyCurve);
+        curveToJson("tailVelocityCurve", tailVelocityCurve);
+        json_object_set_new(res, "expectedTailSeconds", json_real(expectedTailSeconds));
+        json_object_set_new(res, "budgetMB", json_real(budgetMB));
+        json_object_set_new(res, "budgetMinutes", json_real(budgetMinutes));
+        json_object_set_new(res, "adaptiveKeyMaxNotes", json_real(adaptiveKeyMaxNotes));
+        auto intsToJson = [res](const char *key, const adaptivePoints_t &pts) {
+            auto p = std::atomic_load(&pts);
+            if (!p)
+                return;
+            auto arr = json_array();
+            for (auto n : *p)
+                json_array_append_new(arr, json_integer(n));
+            json_object_set_new(res, key, arr);
+        };
+        intsToJson("adaptiveKeyNotes", adaptiveKeyNotes);
+        intsToJson("adaptiveVelocityLayers", adaptiveVelocityLayers);
+        {
+            // The last (or current) render's progress, so a session shows how it went
+            const auto &pp = progressPublished;
+            auto lr = json_object();
+            json_object_set_new(lr, "running", json_boolean(pp.running));
+            json_object_set_new(lr, "jobsDone", json_integer(pp.jobsDone));
+            json_object_set_new(lr, "jobsTotal", json_integer(pp.jobsTotal));
+            json_object_set_new(lr, "elapsedSeconds", json_real(pp.elapsedSeconds));
+            json_object_set_new(lr, "etaSeconds", json_real(pp.etaSeconds));
+            json_object_set_new(lr, "mbWritten", json_real(pp.mbWritten()));
+            json_object_set_new(lr, "mbPerSecond", json_real(pp.mbPerSecond()));
+            json_object_set_new(lr, "jobsPerHour", json_real(pp.jobsPerHour()));
+            json_object_set_new(res, "lastRender", lr);
+        }
+        json_object_set_new(res, "adaptiveGate", json_boolean(adaptiveGate));
+        json_object_set_new(res, "adaptiveGateMinSeconds", json_real(adaptiveGateMinSeconds));
+        json_object_set_new(res, "adaptiveGateHoldSeconds", json_real(adaptiveGateHoldSeconds));
         return res;
     }
 
@@ -297,61 +502,390 @@ struct SampleCreatorModule : virtual rack::Module,
         {
             currentSampleDir = fs::path{*popt};
         }
+        auto sf2opt = jh::jsonSafeGet<bool>(rootJ, "sf2TwentyFourBit");
+        if (sf2opt.has_value())
+        {
+            sf2TwentyFourBit = *sf2opt;
+        }
+        auto lopt = jh::jsonSafeGet<int>(rootJ, "sampleLayout");
+        if (lopt.has_value() && *lopt >= FLAT_LAYOUT && *lopt <= HASHED_LAYOUT)
+        {
+            sampleLayout = (SampleLayout)*lopt;
+        }
+        auto skJ = json_object_get(rootJ, "skipExisting");
+        if (skJ)
+        {
+            skipExisting = json_is_true(skJ);
+        }
+        auto jsopt = jh::jsonSafeGet<std::string>(rootJ, "jobSelection");
+        if (jsopt.has_value())
+        {
+            editJobSelection([&jsopt](auto &sel) { return sel.parse(*jsopt); });
+        }
+        auto seedJ = json_object_get(rootJ, "rrSeed");
+        if (seedJ && json_is_integer(seedJ))
+        {
+            rrSeed = (uint32_t)json_integer_value(seedJ);
+        }
+        auto schopt = jh::jsonSafeGet<int>(rootJ, "scheduling");
+        if (schopt.has_value() && *schopt >= LOCKSTEP && *schopt <= OVERLAPPED)
+        {
+            scheduling = (Scheduling)*schopt;
+        }
+        auto jopt = jh::jsonSafeGet<int>(rootJ, "jobOrdering");
+        if (jopt.has_value() && *jopt >= IN_ORDER && *jopt <= COARSE_TO_FINE)
+        {
+            jobOrdering = (JobOrder)*jopt;
+        }
+        auto mopt = jh::jsonSafeGet<int>(rootJ, "maxOverlap");
+        if (mopt.has_value())
+        {
+            maxOverlap = std::clamp(*mopt, 0, maxVoices);
+        }
+        auto oropt = jh::jsonSafeGet<int>(rootJ, "overloadRetries");
+        if (oropt.has_value())
+        {
+            overloadRetries = std::clamp(*oropt, 0, maxOverloadRetries);
+        }
+        auto shmopt = jh::jsonSafeGet<int>(rootJ, "shardMode");
+        if (shmopt.has_value() && *shmopt >= NO_SHARDS && *shmopt <= QUEUE_SHARD)
+        {
+            shardMode = (ShardMode)*shmopt;
+        }
+        auto shcopt = jh::jsonSafeGet<int>(rootJ, "shardCount");
+        if (shcopt.has_value())
+        {
+            shardCount = std::clamp(*shcopt, 2, maxShards);
+        }
+        auto shiopt = jh::jsonSafeGet<int>(rootJ, "shardIndex");
+        if (shiopt.has_value())
+        {
+            shardIndex = std::clamp(*shiopt, 0, shardCount - 1);
+        }
+        auto idopt = jh::jsonSafeGet<std::string>(rootJ, "instanceId");
+        if (idopt.has_value() && !idopt->empty())
+        {
+            instanceId = (uint32_t)std::strtoul(idopt->c_str(), nullptr, 16);
+        }
+        auto smopt = jh::jsonSafeGet<int>(rootJ, "silenceMode");
+        if (smopt.has_value() && *smopt >= silence::SilenceDetector::PEAK &&
+            *smopt <= silence::SilenceDetector::RMS)
+        {
+            silenceSettings.mode = (silence::SilenceDetector::Mode)*smopt;
+        }
+        auto realFrom = [rootJ](const char *key, float &onto, float lo, float hi) {
+            auto j = json_object_get(rootJ, key);
+            if (j && json_is_number(j))
+                onto = std::clamp((float)json_number_value(j), lo, hi);
+        };
+        realFrom("silenceThresholdDb", silenceSettings.thresholdDb, -160.f, 0.f);
+        realFrom("silenceHoldMs", silenceHoldMs, 1.f, 10000.f);
+        realFrom("maxTailSeconds", maxTailSeconds, 0.f, 3600.f);
+        auto trJ = json_object_get(rootJ, "trimLeadingSilence");
+        if (trJ)
+        {
+            trimLeadingSilence = json_is_true(trJ);
+        }
+        auto asJ = json_object_get(rootJ, "adaptiveSettle");
+        if (asJ)
+        {
+            adaptiveSettle = json_is_true(asJ);
+        }
+        auto agJ = json_object_get(rootJ, "adaptiveGate");
+        if (agJ)
+        {
+            adaptiveGate = json_is_true(agJ);
+        }
+        realFrom("adaptiveGateMinSeconds", adaptiveGateMinSeconds, 0.f, 16.f);
+        realFrom("adaptiveGateHoldSeconds", adaptiveGateHoldSeconds, 0.f, 16.f);
+        realFrom("expectedTailSeconds", expectedTailSeconds, 0.f, 600.f);
+        realFrom("budgetMB", budgetMB, 0.f, 1e7f);
+        realFrom("budgetMinutes", budgetMinutes, 0.f, 1e6f);
+        realFrom("adaptiveKeyMaxNotes", adaptiveKeyMaxNotes, 2.f, 128.f);
+
+        auto intsFrom = [rootJ](const char *key, adaptivePoints_t &onto, int lo) {
+            std::shared_ptr<std::vector<int>> pts;
+            auto arr = json_object_get(rootJ, key);
+            if (arr && json_is_array(arr))
+            {
+                pts = std::make_shared<std::vector<int>>();
+                for (size_t i = 0; i < json_array_size(arr); ++i)
+                {
+                    auto n = json_array_get(arr, i);
+                    if (json_is_integer(n))
+                        pts->push_back(std::clamp((int)json_integer_value(n), lo, 127));
+                }
+            }
+            std::atomic_store(&onto, adaptivePoints_t(pts));
+        };
+        intsFrom("adaptiveKeyNotes", adaptiveKeyNotes, 0);
+        intsFrom("adaptiveVelocityLayers", adaptiveVelocityLayers, 1);
+
+        auto lr = json_object_get(rootJ, "lastRender");
+        if (lr && json_is_object(lr))
+        {
+            auto num = [lr](const char *k) {
+                auto j = json_object_get(lr, k);
+                return (j && json_is_number(j)) ? json_number_value(j) : 0.0;
+            };
+            // a render which was running when saved isn't running now
+            progressPublished.running = false;
+            progressPublished.jobsDone = (int)num("jobsDone");
+            progressPublished.jobsTotal = (int)num("jobsTotal");
+            progressPublished.elapsedSeconds = num("elapsedSeconds");
+            progressPublished.etaSeconds = num("etaSeconds");
+            progressPublished.bytesWritten = num("mbWritten") * 1024.0 * 1024.0;
+        }
+
+        auto curveFrom = [rootJ](const char *key, curvePtr_t &ontoPtr) {
+            auto arr = json_object_get(rootJ, key);
+            if (!arr || !json_is_array(arr))
+                return;
+            curve::BreakpointCurve onto;
+            for (size_t i = 0; i < json_array_size(arr); ++i)
+            {
+                auto pt = json_array_get(arr, i);
+                // the curves scale the gate and tail, so keep a hand edited patch sane
+                if (json_is_array(pt) && json_array_size(pt) == 2)
+                    onto.points.emplace_back(
+                        json_number_value(json_array_get(pt, 0)),
+                        std::clamp((float)json_number_value(json_array_get(pt, 1)), 0.f, 64.f));
+            }
+            onto.sort();
+            setCurve(ontoPtr, onto);
+        };
+        curveFrom("gateKeyCurve", gateKeyCurve);
+        curveFrom("gateVelocityCurve", gateVelocityCurve);
+        curveFrom("tailKeyCurve", tailKeyCurve);
+        curveFrom("tailVelocityCurve", tailVelocityCurve);
     }
 
     uint64_t playbackPos{0};
 
+    /*
+     * The module as a whole moves INACTIVE -> NEW_NOTE -> RECORDING -> SPINDOWN_BUFFER and
+     * back to NEW_NOTE. While RECORDING each voice moves through GATED_RECORD and then
+     * RELEASE_RECORD or GATE_RELEASE_FADE, and back to INACTIVE when its take is done.
+     */
     enum CreateState
     {
         INACTIVE,
         NEW_NOTE,
+        RECORDING,
         GATED_RECORD,
         RELEASE_RECORD,
         GATE_RELEASE_FADE,
         SPINDOWN_BUFFER,
+        CALIBRATING,
+        PROBING
     } createState{INACTIVE};
 
     fs::path currentSampleDir{}, currentSampleWavDir{};
 
-    riffwav::RIFFWavWriter riffWavWriter;
-    std::ofstream multiFile;
+    static constexpr int maxVoices{16};
+    static constexpr int maxVelocityLayers{127}, maxRoundRobins{64};
+    std::array<riffwav::RIFFWavWriter, maxVoices> riffWavWriters;
+    std::vector<Take> completedTakes; // only touched on the render thread
 
     std::atomic<bool> testMode{false};
     std::atomic<bool> startOperating{false};
+    /*
+     * Set with END_RENDER and cleared once the render thread has finished it (merging
+     * shards and releasing claims can take a while), so a new render doesn't replace the
+     * claim and skip state underneath it.
+     */
+    std::atomic<bool> renderEnding{false};
+    std::atomic<bool> calibrateRequested{false};
     std::atomic<bool> stopImmediately{false};
 
     std::array<std::atomic<float>, 2> vuLevels{0, 0};
 
-    uint64_t gateSamples{0};
-    uint64_t latencySamples{0};
-
-    uint64_t gateInitValue{0};
     uint64_t latencyInitValue{0};
 
     static constexpr int spindownLength{1024};
     static constexpr int gateOnlyFadeLength{1024};
 
-    static constexpr int silenceSamples{4096};
-    int silencePosition;
-    float silenceDetector[silenceSamples];
+    /*
+     * The release in SILENCE mode ends when the detector says the tail is silent, or when
+     * it has run for the job's maxTailSeconds (if set), so a patch with a noise floor still
+     * finishes.
+     */
+    silence::SilenceDetector::Settings silenceSettings;
+    float silenceHoldMs{85.f}; // about the 4096 samples at 48k we used to use
+    float maxTailSeconds{0.f}; // 0 for no limit
+
+    /*
+     * The gate time and maximum tail are scaled per job by these curves over the midi note
+     * and velocity, and baked into the RenderJob in populateRenderJobs. The menu replaces a
+     * curve whole with atomic_store, since the plan builders read them on other threads.
+     */
+    using curvePtr_t = std::shared_ptr<const curve::BreakpointCurve>;
+    curvePtr_t gateKeyCurve{std::make_shared<const curve::BreakpointCurve>()};
+    curvePtr_t gateVelocityCurve{std::make_shared<const curve::BreakpointCurve>()};
+    curvePtr_t tailKeyCurve{std::make_shared<const curve::BreakpointCurve>()};
+    curvePtr_t tailVelocityCurve{std::make_shared<const curve::BreakpointCurve>()};
 
-    struct RenderJob
+    static void setCurve(curvePtr_t &onto, const curve::BreakpointCurve &c)
     {
-        int midiNote, noteFrom, noteTo;
-        int velocity{90}, velFrom, velTo;
-        int roundRobinIndex{0};
-        int roundRobinOutOf{1};
-        float rrRand[2]{0.f, 0.f};
-    };
+        std::atomic_store(&onto, curvePtr_t(std::make_shared<const curve::BreakpointCurve>(c)));
+    }
 
-    std::vector<RenderJob> renderJobs;
+    /*
+     * With an adaptive gate, a note which reaches a steady state (see SteadyStateDetector)
+     * has its gate released adaptiveGateHoldSeconds later, rather than always holding for
+     * the full gate time. The gate time is still the maximum, and we never release before
+     * adaptiveGateMinSeconds.
+     */
+    bool adaptiveGate{false};
+    float adaptiveGateMinSeconds{0.25f};
+    float adaptiveGateHoldSeconds{0.5f};
+    uint64_t adaptiveGateMinSamples{0}, adaptiveGateHoldSamples{0};
+
+    // Drop the frames before the first one above the silence threshold from each take
+    bool trimLeadingSilence{false};
+    float onsetThreshold{1e-6f};
+
+    using RenderJob = samplecreator::RenderJob;
+
+    /*
+     * Plans are published as immutable snapshots (see PlanSnapshot.hpp). The audio thread
+     * makes one as a render starts and hands it to the render thread with START_RENDER, so
+     * for the length of a render both work from the same jobs and order, whatever the UI
+     * publishes meanwhile. Each thread only touches its own pointer.
+     */
+    PlanPublisher plans;
+    PlanPtr audioPlan;             // only used on the audio thread
+    PlanPtr writerPlan;            // only used on the render thread
+    PlanPtr writerPlanHandoff;     // atomic_store on audio, atomic_load on render
     std::atomic<int64_t> currentJobIndex{-1};
+    int64_t nextJobIndex{0}; // a position in the plan order, not the jobs
+
+    /*
+     * Lockstep starts a batch of voices together and waits for every tail before the next
+     * batch. Overlapped starts the next job on any voice as soon as its tail is done and it
+     * has spun down, keeping at most maxOverlap voices sounding. Pitch spread orders the jobs
+     * so the voices sounding together are far apart in pitch, which keeps a synth's voice
+     * allocation from stealing or retriggering a note which is still ringing. Coarse to fine
+     * renders in passes which each leave a playable multi-file; see Progressive.hpp.
+     */
+    enum Scheduling
+    {
+        LOCKSTEP,
+        OVERLAPPED
+    } scheduling{LOCKSTEP};
+    enum JobOrder
+    {
+        IN_ORDER,
+        PITCH_SPREAD,
+        COARSE_TO_FINE
+    } jobOrdering{IN_ORDER};
+    int maxOverlap{0}; // 0 means as many as the polyphony
 
     static constexpr int ioSampleBlockSize{16};
     static constexpr int ioSampleBlocksAvailable{8192};
     float ioBlocks[ioSampleBlocksAvailable][ioSampleBlockSize][2];
-    std::atomic<int> ioWriteBlock{0},
-        ioWritePosition{0}; // don't need to be atomic since only used on audio thread
+    int ioNextBlock{0}; // only used on audio thread
+
+    /*
+     * Overloaded takes. Every voice times its take against the wall clock (see
+     * OverloadMonitor.hpp) and counts the io blocks it pushed while the ring was so full
+     * that the writer could be lapped. Either flags the take: the render thread logs it and
+     * writes the flags to the manifest, and unless it has already been retried
+     * overloadRetries times the audio thread queues the job to record again once the plan
+     * order is done. The retry replaces the take in the multi-file, and its manifest
+     * record supersedes the first one.
+     */
+    static constexpr int maxOverloadRetries{3};
+    static constexpr uint16_t suspectTakeFlags{manifest::TAKE_ENGINE_OVERLOAD |
+                                               manifest::TAKE_TRANSPORT_OVERRUN};
+    int overloadRetries{2};
+    overload::LagClock lagClock;      // only used on audio thread
+    std::vector<int64_t> retryQueue;  // audio thread; reserved as the render starts
+    size_t retryNext{0};              // audio thread
+    std::vector<uint8_t> retryCount;  // audio thread, per job
+    std::atomic<uint64_t> ioBlocksPushed{0}, ioBlocksWritten{0};
+    std::array<uint16_t, maxVoices> takeFlags{}; // render thread, until the take closes
+    std::vector<uint8_t> takeSuspect;            // render thread, per job
+
+    void renderThreadFlagTake(int voice, int64_t jobIndex, int64_t data)
+    {
+        auto flags = (uint16_t)(data & 0xFFFF);
+        auto attempt = (int)(data >> 16);
+        takeFlags[voice] = flags;
+
+        const auto &job = writerPlan->jobs[jobIndex];
+        auto name = midiNoteToName(job.midiNote) + " vel=" + std::to_string(job.velocity) +
+                    " rr=" + std::to_string(job.roundRobinIndex);
+        if (!(flags & suspectTakeFlags))
+        {
+            pushMessage("Re-recorded " + name + " cleanly");
+            return;
+        }
+        std::string why = (flags & manifest::TAKE_ENGINE_OVERLOAD) ? "engine overload" : "";
+        if (flags & manifest::TAKE_TRANSPORT_OVERRUN)
+            why += std::string(why.empty() ? "" : " and ") + "transport overrun";
+        if (flags & manifest::TAKE_REQUEUED)
+            pushError("Take " + name + " hit " + why + "; re-recording it at the end (retry " +
+                      std::to_string(attempt) + " of " + std::to_string(overloadRetries) + ")");
+        else
+            pushError("Take " + name + " hit " + why + "; flagged in the manifest");
+    }
+
+    void renderThreadReportSuspectTakes()
+    {
+        auto n = std::count(takeSuspect.begin(), takeSuspect.end(), 1);
+        if (n > 0)
+            pushError(std::to_string(n) + " takes may have glitches from engine overload. " +
+                      "They are flagged in the manifest.");
+        takeSuspect.clear();
+    }
+
+    /*
+     * With POLYPHONY above one, each channel of the polyphonic V/Oct, gate and velocity
+     * outputs plays a different job and the matching channel of the polyphonic input is
+     * recorded to its own take. A voice is only touched on the audio thread; its writer
+     * lives in riffWavWriters on the render thread.
+     */
+    struct Voice
+    {
+        CreateState state{INACTIVE};
+        int64_t jobIndex{-1};
+        uint64_t playbackPos{0};
+        uint64_t gateSamples{0};
+        uint64_t latencySamples{0};
+        uint64_t maxTailSamples{0};
+
+        silence::SilenceDetector detector;
+        bool awaitingOnset{false};
+        silence::SilenceDetector settle;
+        steadystate::SteadyStateDetector steady;
+        bool gateAdapted{false};
+
+        int ioBlock{0}, ioPosition{0};
+        uint64_t idleSamples{0};
+        overload::TakeTiming timing;
+    };
+    std::array<Voice, maxVoices> voices;
+    std::array<std::atomic<int64_t>, maxVoices> voiceJobIndex; // for the UI
+    int nVoices{1};
+    bool warnedInputChannels{false};
+
+    bool isVoiceJob(int64_t idx) const
+    {
+        if (idx < 0)
+            return false;
+        for (const auto &v : voiceJobIndex)
+            if (v == idx)
+                return true;
+        return false;
+    }
+    int activeVoiceCount() const
+    {
+        int res{0};
+        for (const auto &v : voiceJobIndex)
+            res += v >= 0;
+        return res;
+    }
 
     std::unique_ptr<std::thread> renderThread;
     std::atomic<bool> keepRunning{true};
@@ -362,22 +896,39 @@ struct SampleCreatorModule : virtual rack::Module,
         {
             START_RENDER,
             END_RENDER,
-            NEW_NOTE, // data is a job index
-            CLOSE_FILE,
-            PUSH_SAMPLES,
-            PUSH_SINGLE_SAMPLE,
+            NEW_NOTE,     // data is a job index, data2 the sample rate
+            CLOSE_FILE,   // data is a job index, data2 the frames after gate release
+            PUSH_SAMPLES, // data is an io block, data2 the frames in it
+            FLAG_TAKE,    // data is a job index, data2 its TakeFlags and attempt << 16
         } message;
 
         int64_t data{0};
         int64_t data2{0};
 
-        float samplL{0.f}, sampR{0.f};
+        int voice{0};
+        bool aborted{false}; // CLOSE_FILE: cut short by Stop, so the take is thrown away
     };
     sst::cpputils::SimpleRingBuffer<RenderThreadCommand, 4096 * 16> renderThreadCommands;
     void renderThreadProcess()
     {
         while (keepRunning)
         {
+            if (rewrapRequested)
+            {
+                renderThreadRewrap();
+                rewrapRequested = false;
+            }
+            if (clearClaimsRequested)
+            {
+                renderThreadClearClaims();
+                clearClaimsRequested = false;
+            }
+            if (probeAnalyzeRequested)
+            {
+                renderThreadAnalyzeProbe();
+                probeAnalyzeRequested = false;
+            }
+            renderThreadClaimAhead();
             while (keepRunning && !renderThreadCommands.empty())
             {
                 auto oc = renderThreadCommands.pop();
@@ -387,47 +938,93 @@ struct SampleCreatorModule : virtual rack::Module,
                     {
                     case RenderThreadCommand::START_RENDER:
                     {
+                        writerPlan = std::atomic_load(&writerPlanHandoff);
                         if (!testMode)
                         {
                             sampleMultiFileStart();
+                            if (queueSharding)
+                                renderThreadClaimInstance();
+                            manifestStart();
+                            if (skipExisting || renderingSelection)
+                                renderThreadFindExistingTakes();
+                            claimPosition = 0;
+                            claimedElsewhere = 0;
+                            if (queueSharding)
+                            {
+                                std::error_code ec;
+                                fs::create_directories(currentSampleDir / "claims", ec);
+                            }
+                            claimingActive = queueSharding;
+                            renderThreadClaimAhead();
+                            progressStart();
+                            checkpointStart();
+                            takeFlags.fill(0);
+                            takeSuspect.assign(writerPlan->jobs.size(), 0);
                         }
+                        existingScanComplete = true;
                     }
                     break;
                     case RenderThreadCommand::END_RENDER:
                     {
                         pushMessage("END RENDER");
-                        if (!testMode)
+                        progressPublished.running = false;
+                        renderThreadReportSuspectTakes();
+                        claimingActive = false;
+                        if (!testMode && renderLayout.shardMode != NO_SHARDS)
+                        {
+                            manifestWriter.closeFile();
+                            renderThreadMergeShards();
+                        }
+                        else if (!testMode)
                         {
                             sampleMultiFileEnd();
+                            manifestWriter.closeFile();
                         }
+                        checkpointsActive = false;
+                        renderEnding = false;
                     }
                     break;
                     case RenderThreadCommand::NEW_NOTE:
-                        renderThreadNewNote(oc->data, oc->data2);
+                        renderThreadNewNote(oc->voice, oc->data, oc->data2);
                         break;
                     case RenderThreadCommand::CLOSE_FILE:
-                        if (riffWavWriter.isOpen())
+                    {
+                        auto &rw = riffWavWriters[oc->voice];
+                        if (rw.isOpen() && oc->aborted)
+                        {
+                            renderThreadDiscardTake(rw);
+                        }
+                        else if (rw.isOpen())
                         {
-                            if (!riffWavWriter.closeFile())
+                            if (!rw.closeFile())
+                            {
+                                pushMessage(rw.errMsg);
+                            }
+                            auto job = writerPlan->jobs[oc->data];
+                            auto flags = takeFlags[oc->voice];
+                            auto retake = (flags & manifest::TAKE_RERECORDED) != 0;
+                            sampleMultiFileAddCurrentJob(job, rw, retake);
+                            manifestAddCurrentJob(job, rw, takeMetrics[oc->voice], oc->data2,
+                                                  flags);
+                            if (!retake)
                             {
-                                pushMessage(riffWavWriter.errMsg);
+                                progressTakeDone(oc->data, rw);
+                                checkpointTakeDone(oc->data);
                             }
-                            sampleMultiFileAddCurrentJob(renderJobs[oc->data], riffWavWriter);
+                            if (oc->data < (int64_t)takeSuspect.size())
+                                takeSuspect[oc->data] = (flags & suspectTakeFlags) != 0;
                         }
-                        break;
-                    case RenderThreadCommand::PUSH_SAMPLES:
-                    {
-                        updateVU(oc->data);
-                        renderThreadWriteBlock(oc->data);
+                        takeFlags[oc->voice] = 0;
                     }
                     break;
-                    case RenderThreadCommand::PUSH_SINGLE_SAMPLE:
+                    case RenderThreadCommand::FLAG_TAKE:
+                        renderThreadFlagTake(oc->voice, oc->data, oc->data2);
+                        break;
+                    case RenderThreadCommand::PUSH_SAMPLES:
                     {
-                        if (!testMode && riffWavWriter.isOpen())
-                        {
-                            float f2[2]{oc->samplL, oc->sampR};
-                            riffWavWriter.pushSamples(f2);
-                        }
+                        updateVU(oc->data, oc->data2);
+                        renderThreadWriteBlock(oc->voice, oc->data, oc->data2);
+                        ioBlocksWritten++;
                     }
                     break;
                     default:
@@ -440,574 +1037,2338 @@ struct SampleCreatorModule : virtual rack::Module,
         }
     }
 
-    void renderThreadNewNote(int jobid, double sr)
+    /*
+     * A take Stop cut short still gets a complete header and a matching fingerprint when
+     * it closes, so skip existing would keep it for good. Remove it instead, and leave it
+     * out of the multi-file, the manifest and the progress.
+     */
+    void renderThreadDiscardTake(riffwav::RIFFWavWriter &rw)
+    {
+        if (!rw.closeFile())
+            pushMessage(rw.errMsg);
+        std::error_code ec;
+        fs::remove(rw.outPath, ec);
+        if (ec)
+            pushError("Unable to remove stopped take '" + rw.outPath.u8string() +
+                      "' : " + ec.message());
+        else
+            pushMessage("Removed '" + rw.outPath.filename().u8string() + "', cut short by stop");
+    }
+
+    void renderThreadNewNote(int voice, int jobid, double sr)
     {
-        auto &currentJob = renderJobs[jobid];
+        auto currentJob = writerPlan->jobs[jobid];
         pushMessage(std::string("Starting note ") + midiNoteToName(currentJob.midiNote) +
                     " vel=" + std::to_string(currentJob.velocity) +
                     " rr=" + std::to_string(currentJob.roundRobinIndex));
 
-        auto bn = std::string("sample") + "_note_" + std::to_string((int)currentJob.midiNote) +
-                  "_vel_" + std::to_string((int)currentJob.velocity) + "_rr_" +
-                  std::to_string((int)currentJob.roundRobinIndex) + ".wav";
-        auto fn = currentSampleWavDir / bn;
+        auto fn = currentSampleWavDir / sampleRelativePath(currentJob);
+        takeMetrics[voice].reset();
+        currentSampleRate = (int32_t)sr;
         if (!testMode)
         {
+            if (renderLayout.sampleLayout != FLAT_LAYOUT)
+            {
+                try
+                {
+                    fs::create_directories(fn.parent_path());
+                }
+                catch (const fs::filesystem_error &e)
+                {
+                    pushError(std::string() + "Unable to create sample directory : " + e.what());
+                }
+            }
             int nChannels = inputs[INPUT_R].isConnected() ? 2 : 1;
             pushMessage("Writing '" + fn.filename().u8string() + "'");
             pushMessage(std::string("   - 32 bit ") + (nChannels == 2 ? "stereo" : "mono") + " @ " +
                         std::to_string(sr) + " sr");
-            riffWavWriter = riffwav::RIFFWavWriter(fn, nChannels);
-            auto opened = riffWavWriter.openFile();
+            auto &rw = riffWavWriters[voice];
+            rw = riffwav::RIFFWavWriter(fn, nChannels);
+            auto opened = rw.openFile();
             if (!opened)
             {
-                pushError(riffWavWriter.errMsg);
+                pushError(rw.errMsg);
             }
-            riffWavWriter.writeRIFFHeader();
-            riffWavWriter.writeFMTChunk(sr);
-            riffWavWriter.writeINSTChunk(currentJob.midiNote, currentJob.noteFrom,
-                                         currentJob.noteTo, currentJob.velFrom, currentJob.velTo);
-            riffWavWriter.startDataChunk();
+            rw.writeRIFFHeader();
+            rw.writeFMTChunk(sr);
+            rw.writeINSTChunk(currentJob.midiNote, currentJob.noteFrom, currentJob.noteTo,
+                              currentJob.velFrom, currentJob.velTo);
+            rw.writeFingerprintChunk(fingerprint(currentJob, renderSettings));
+            rw.startDataChunk();
+        }
+    }
+
+    /*
+     * Where a job's wav goes, relative to the wav directory. With 16k takes a single
+     * directory gets slow to list on some filesystems and in some samplers, so we can
+     * shard into a note / velocity tree or a fixed 256 way hashed fan-out.
+     */
+    fs::path sampleRelativePath(const RenderJob &job)
+    {
+        auto nt = std::to_string(job.midiNote);
+        auto vl = std::to_string(job.velocity);
+        auto rr = std::to_string(job.roundRobinIndex);
+        auto flat = "sample_note_" + nt + "_vel_" + vl + "_rr_" + rr + ".wav";
+
+        switch (renderLayout.sampleLayout)
+        {
+        case NOTE_VELOCITY_LAYOUT:
+            return fs::path{"note_" + nt} / ("vel_" + vl) / ("rr_" + rr + ".wav");
+        case HASHED_LAYOUT:
+        {
+            // FNV-1a, so the bucket is stable across runs and platforms
+            uint32_t h{2166136261u};
+            for (auto c : flat)
+                h = (h ^ (uint8_t)c) * 16777619u;
+            char bucket[4];
+            snprintf(bucket, sizeof(bucket), "%02x", h & 0xFF);
+            return fs::path{bucket} / flat;
+        }
+        case FLAT_LAYOUT:
+        default:
+            break;
         }
+        return fs::path{flat};
     }
 
-    void renderThreadWriteBlock(int whichBlock)
+    void renderThreadWriteBlock(int voice, int whichBlock, int nFrames)
     {
         if (testMode)
             return;
-        if (!riffWavWriter.outf)
+        auto &rw = riffWavWriters[voice];
+        if (!rw.outf)
         {
             pushError("Attempted to write to unopened file");
             return;
         }
         auto *data = &(ioBlocks[whichBlock][0][0]);
-        if (riffWavWriter.nChannels == 2)
+        if (rw.nChannels == 2)
         {
-            riffWavWriter.pushInterleavedBlock(data, ioSampleBlockSize * 2);
+            rw.pushInterleavedBlock(data, nFrames * 2);
+            takeMetrics[voice].accumulate(data, nFrames * 2, 2);
         }
-        if (riffWavWriter.nChannels == 1)
+        if (rw.nChannels == 1)
         {
             float md[ioSampleBlockSize];
-            for (int i = 0; i < ioSampleBlockSize; ++i)
+            for (int i = 0; i < nFrames; ++i)
             {
                 md[i] = data[i * 2];
             }
-            riffWavWriter.pushInterleavedBlock(data, ioSampleBlockSize);
+            rw.pushInterleavedBlock(md, nFrames);
+            takeMetrics[voice].accumulate(md, nFrames, 1);
         }
     }
 
     /*
-     * These write the multifile (SFZ, BWS, Descent, etc...)
+     * The manifest gets a record per take with the job and the metrics we gathered while
+     * writing it. See Manifest.hpp.
      */
-    void sampleMultiFileStart()
+    manifest::ManifestWriter manifestWriter;
+    std::array<manifest::TakeMetrics, maxVoices> takeMetrics;
+    int32_t currentSampleRate{48000};
+
+    std::map<std::string, manifest::TakeRecord> previousManifest;
+
+    void manifestStart()
     {
-        switch (multiFormat)
-        {
-        case JUST_WAV:
-            pushMessage("Wav Files Only - no multi-sample format created");
-            break;
-        case SFZ:
+        // Keep the old records so takes we skip can carry theirs over
+        previousManifest.clear();
+        auto mp = manifestPath();
+        if (fs::exists(mp))
         {
-            auto bn = currentSampleDir.filename().replace_extension();
-            auto fn = (currentSampleDir / bn.u8string()).replace_extension("sfz");
-            pushMessage("MultiFile Format: SFZ");
-            pushMessage("   - '" + fn.filename().u8string() + "'");
-            multiFile = std::ofstream(fn);
-            if (!multiFile.is_open())
-            {
-                pushError("Failed to open output MultiFile");
-            }
-            else
-            {
-                multiFile << "// Basic SFZ File from Rack Sample Creator\n\n";
-                multiFile << "<global>\n" << std::flush;
-
-                multiFile << "<group>";
-                if (renderJobs.size() > 0 && renderJobs[0].roundRobinOutOf > 1)
-                    multiFile << " seq_length=" << renderJobs[0].roundRobinOutOf;
-                multiFile << "\n";
-            }
+            manifest::ManifestReader rd(mp);
+            if (rd.openFile())
+                for (const auto &r : rd.readAll())
+                    previousManifest[r.path] = r;
         }
-        break;
-        case DECENT:
+        if (!manifestWriter.openFile(mp))
+            pushError(manifestWriter.errMsg);
+    }
+
+    void manifestAddExistingTake(const RenderJob &job, riffwav::RIFFWavReader &rd,
+                                 const std::string &rel)
+    {
+        manifest::TakeRecord r;
+        auto pm = previousManifest.find(rel);
+        if (pm != previousManifest.end() && pm->second.frameCount == rd.getSampleCount())
         {
-            auto bn = currentSampleDir.filename().replace_extension();
-            auto fn = (currentSampleDir / bn.u8string()).replace_extension("dspreset");
-            pushMessage("MultiFile Format: Decent Sampler");
-            pushMessage("   - '" + fn.filename().u8string() + "'");
-            multiFile = std::ofstream(fn);
-            if (!multiFile.is_open())
-            {
-                pushError("Failed to open output MultiFile");
-            }
-            else
-            {
-                multiFile << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n";
-                multiFile << "<DecentSampler minVersion=\"1.0.0\">\n"
-                          << "  <groups>\n"
-                          << "    <group>\n"
-                          << std::flush;
-            }
+            r = pm->second;
         }
-        break;
-        case MULTISAMPLE:
+        else
         {
-            auto fn = currentSampleWavDir / "multisample.xml";
+            manifest::TakeMetrics tm;
+            std::vector<float> d(1024 * rd.nChannels);
+            size_t got;
+            while ((got = rd.readInterleavedBlock(d.data(), 1024)) > 0)
+                tm.accumulate(d.data(), got * rd.nChannels, rd.nChannels);
+            r.sampleRate = rd.sampleRate;
+            r.nChannels = rd.nChannels;
+            r.frameCount = rd.getSampleCount();
+            r.peak = tm.peak;
+            r.rms = tm.rms(rd.nChannels);
+            r.hash = tm.hash;
+            r.dataOffset = rd.dataStart;
+            strncpy(r.path, rel.c_str(), sizeof(r.path) - 1);
+        }
+        r.fromJob(job);
+        if (rd.hasFingerprint)
+            r.fingerprint = rd.fingerprint;
+        manifestWriter.push(r);
+    }
 
-            multiFile = std::ofstream(fn);
-            if (!multiFile.is_open())
-            {
-                pushError("Failed to open output MultiFile");
-            }
-            else
+    void renderThreadFindExistingTakes()
+    {
+        const auto &renderJobs = writerPlan->jobs;
+        int skipped{0}, kept{0}, suspect{0};
+        for (size_t i = 0; i < renderJobs.size(); ++i)
+        {
+            // takes outside a selection are kept as they are; in it they always re-render
+            auto keep = jobSkipped[i] == 3;
+            if ((jobSkipped[i] && !keep) || (!keep && (!skipExisting || renderingSelection)))
+                continue;
+            const auto &job = renderJobs[i];
+            auto rel = sampleRelativePath(job);
+            auto fn = currentSampleWavDir / rel;
+            if (!fs::exists(fn))
+                continue;
+
+            riffwav::RIFFWavReader rd(fn);
+            if (!rd.openFile() || !rd.headerComplete)
+                continue;
+            if (!keep &&
+                (!rd.hasFingerprint || rd.fingerprint != fingerprint(job, renderSettings)))
+                continue;
+
+            // a take last written under overload may never have been re-recorded
+            auto pm = previousManifest.find(rel.generic_u8string());
+            if (pm != previousManifest.end() && (pm->second.flags & suspectTakeFlags))
             {
-                auto nm = currentSampleDir.filename().replace_extension();
-                multiFile << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n";
-                multiFile << "<multisample name=\"" << nm.u8string() << "\">\n" << std::flush;
+                suspect++;
+                if (!keep)
+                    continue;
             }
+
+            if (!keep)
+                jobSkipped[i] = 1;
+            completedTakes.push_back({job, rel, rd.getSampleCount()});
+            manifestAddExistingTake(job, rd, rel.generic_u8string());
+            (keep ? kept : skipped)++;
         }
-        break;
-        }
+        if (skipped > 0)
+            pushMessage("Skipping " + std::to_string(skipped) + " of " +
+                        std::to_string(renderJobs.size()) + " jobs already on disk");
+        if (renderingSelection)
+            pushMessage("Keeping " + std::to_string(kept) + " takes outside the selection");
+        if (suspect > 0)
+            pushMessage(std::to_string(suspect) + " takes on disk were flagged for overload" +
+                        (renderingSelection ? "; select them to re-render them"
+                                            : " and will be re-rendered"));
     }
 
-    void sampleMultiFileEnd()
+    // Each shard writes its own manifest so they never write the same file
+    fs::path manifestPath() const
     {
-        switch (multiFormat)
+        std::string id;
+        switch (renderLayout.shardMode)
         {
-        case JUST_WAV:
+        case FIXED_SHARD:
+            id = "shard-" + std::to_string(renderLayout.shardIndex + 1) + "-of-" +
+                 std::to_string(renderLayout.shardCount);
             break;
-        case SFZ:
+        case QUEUE_SHARD:
         {
-            if (multiFile.is_open())
-            {
-                pushMessage("Closing SFZ File");
-                multiFile.close();
-            }
+            char hx[16];
+            snprintf(hx, sizeof(hx), "%08x", instanceId.load());
+            id = hx;
         }
         break;
-        case DECENT:
-        {
-            if (multiFile.is_open())
-            {
-                multiFile << "   </group>\n  </groups>\n";
-                multiFile << "</DecentSampler>" << std::flush;
-                pushMessage("Closing .dspreset File");
-                multiFile.close();
-            }
+        default:
+            return currentSampleDir / manifest::fileName;
         }
-        break;
-        case MULTISAMPLE:
-            if (multiFile.is_open())
-            {
-                multiFile << "</multisample>" << std::flush;
-                pushMessage("Closing multisample.xml File");
-                multiFile.close();
+        return currentSampleDir /
+               (std::string(manifest::fileStem) + "." + id + manifest::fileExtension);
+    }
 
-                auto zf = (currentSampleDir / currentSampleDir.filename())
-                              .replace_extension(".multisample");
+    // On the audio thread as the render starts
+    void shardAssignJobs()
+    {
+        const auto &renderJobs = audioPlan->jobs;
+        /*
+         * Shard by the index in the jobs rather than the position in the order, since the
+         * order depends on the polyphony which needn't match between the copies
+         */
+        const auto &rl = renderLayout;
+        if (rl.shardMode == FIXED_SHARD)
+        {
+            auto k = std::clamp(rl.shardIndex, 0, rl.shardCount - 1);
+            for (size_t i = 0; i < renderJobs.size(); ++i)
+                if ((int)(i % rl.shardCount) != k && !jobSkipped[i])
+                    jobSkipped[i] = 2;
+        }
 
-                pushMessage("Creating zip : " + zf.u8string());
-                ziparchive::zipDirToOutputFrom(zf, currentSampleWavDir);
-            }
+        queueSharding = rl.shardMode == QUEUE_SHARD && !testMode;
+        if (queueSharding)
+        {
+            jobClaims = std::make_unique<std::atomic<uint8_t>[]>(renderJobs.size());
+            for (size_t i = 0; i < renderJobs.size(); ++i)
+                jobClaims[i] = CLAIM_PENDING;
         }
+        jobsStarted = 0;
     }
 
-    void sampleMultiFileAddCurrentJob(const RenderJob &currentJob, const riffwav::RIFFWavWriter &rw)
+    fs::path claimPath(const RenderJob &job) const
     {
-        auto &fn = rw.outPath;
-        switch (multiFormat)
-        {
-        case SFZ:
-        {
-            if (!multiFile.is_open())
-                return;
+        return currentSampleDir / "claims" /
+               ("note_" + std::to_string(job.midiNote) + "_vel_" + std::to_string(job.velocity) +
+                "_rr_" + std::to_string(job.roundRobinIndex));
+    }
 
-            multiFile << "<region>";
-            if (currentJob.roundRobinOutOf > 1)
-                multiFile << " seq_position=" << (currentJob.roundRobinIndex + 1);
-            multiFile << " sample=wav/" << fn.filename().u8string().c_str()
-                      << " lokey=" << currentJob.noteFrom << " hikey=" << currentJob.noteTo
-                      << " pitch_keycenter=" << currentJob.midiNote
-                      << " lovel=" << currentJob.velFrom << " hivel=" << currentJob.velTo << "\n"
-                      << std::flush;
-        }
-        break;
-        case DECENT:
+    // Claim a couple of batches ahead of the audio thread, so it rarely waits on the disk
+    void renderThreadClaimAhead()
+    {
+        if (!claimingActive)
+            return;
+
+        const auto &renderJobs = writerPlan->jobs;
+        const auto &jobOrder = writerPlan->order;
+        auto horizon = std::min((int64_t)jobOrder.size(), jobsStarted + 2 * (int64_t)maxVoices);
+        while (claimPosition < horizon)
         {
-            if (!multiFile.is_open())
-                return;
-            multiFile << "    <sample ";
-            multiFile << "path=\"wav/" << fn.filename().u8string().c_str() << "\" "
-                      << "loNote=\"" << currentJob.noteFrom << "\" "
-                      << "hiNote=\"" << currentJob.noteTo << "\" "
-                      << "rootNote=\"" << currentJob.midiNote << "\" "
-                      << "loVel=\"" << currentJob.velFrom << "\" "
-                      << "hiVel=\"" << currentJob.velTo << "\" " << std::flush;
+            auto ji = jobOrder[claimPosition++];
+            if (jobSkipped[ji])
+                continue;
 
-            if (currentJob.roundRobinOutOf > 1)
-                multiFile << " seqMode=\"round_robin\" seqLength=\"" << currentJob.roundRobinOutOf
-                          << "\" "
-                          << " seqPosition=\"" << currentJob.roundRobinIndex + 1 << "\" ";
+            std::error_code ec;
+            auto mine = fs::create_directory(claimPath(renderJobs[ji]), ec);
+            if (ec)
+            {
+                // better to render it twice than not at all
+                pushError("Unable to claim job : " + ec.message());
+                mine = true;
+            }
+            jobClaims[ji] = mine ? CLAIM_MINE : CLAIM_ELSEWHERE;
+            if (!mine)
+            {
+                claimedElsewhere++;
+                progressPublished.jobsTotal--;
+                progressRemaining.remove(renderJobs.gateSeconds[ji], renderJobs.midiNote[ji],
+                                         renderJobs.velocity[ji]);
+            }
+        }
+        if (claimPosition >= (int64_t)jobOrder.size())
+            claimingActive = false;
+    }
+
+    /*
+     * A shared queue shard names its manifest after instanceId, which is saved with the
+     * patch so a copy keeps adding to one manifest across sessions rather than leaving a
+     * new one each time. A duplicated patch carries the same id, so each render holds
+     * claims/instance-<id> while it runs and takes a fresh id if a running shard has it.
+     */
+    fs::path instanceClaimPath() const
+    {
+        char hx[16];
+        snprintf(hx, sizeof(hx), "%08x", instanceId.load());
+        return currentSampleDir / "claims" / (std::string("instance-") + hx);
+    }
 
-            multiFile << "/>\n";
+    void renderThreadClaimInstance()
+    {
+        std::error_code ec;
+        fs::create_directories(currentSampleDir / "claims", ec);
+        for (int attempt = 0; attempt < 16; ++attempt)
+        {
+            if (fs::create_directory(instanceClaimPath(), ec))
+                return;
+            if (ec)
+            {
+                pushError("Unable to claim a manifest : " + ec.message());
+                return;
+            }
+            instanceId = rack::random::u32();
         }
-        break;
+    }
+
+    // Let another shard pick up anything we claimed but didn't finish
+    void renderThreadReleaseClaims()
+    {
+        const auto &renderJobs = writerPlan->jobs;
+        if (!queueSharding || !jobClaims)
+            return;
+        std::error_code iec;
+        fs::remove(instanceClaimPath(), iec);
+        for (size_t i = 0; i < renderJobs.size(); ++i)
+        {
+            if (jobClaims[i] != CLAIM_MINE || progressJobDone[i])
+                continue;
+            std::error_code ec;
+            fs::remove(claimPath(renderJobs[i]), ec);
+        }
+        if (claimedElsewhere > 0)
+            pushMessage(std::to_string(claimedElsewhere) + " jobs were claimed by other shards");
+    }
+
+    // From the menu, to recover after a shard was killed mid render
+    void renderThreadClearClaims()
+    {
+        setupOutputFormatAndDirectories();
+        std::error_code ec;
+        auto n = fs::remove_all(currentSampleDir / "claims", ec);
+        if (ec)
+            pushError("Unable to clear claims : " + ec.message());
+        else
+            pushMessage("Cleared " + std::to_string(n > 0 ? n - 1 : 0) + " shard claims");
+    }
+
+    /*
+     * Under a lock (another directory) so two shards finishing together don't write the
+     * multi-file at once, gather every shard's takes from their manifests and write the
+     * multi-file over all of them. Old manifests can list takes from some other plan, so
+     * only keep the ones this plan would write.
+     */
+    void renderThreadMergeShards()
+    {
+        const auto &renderJobs = writerPlan->jobs;
+        renderThreadReleaseClaims();
+
+        auto lock = currentSampleDir / "merge.lock";
+        std::error_code ec;
+        bool locked{false};
+        for (int attempt = 0; attempt < 200 && !locked; ++attempt)
+        {
+            locked = fs::create_directory(lock, ec);
+            if (!locked)
+            {
+                using namespace std::chrono_literals;
+                std::this_thread::sleep_for(50ms);
+            }
+        }
+        if (!locked)
+        {
+            pushError("Unable to lock '" + lock.u8string() +
+                      "'. If no other shard is running, remove it and rewrap.");
+            return;
+        }
+
+        /*
+         * The latest record of each file in the plan whose fingerprint matches the plan and
+         * which is still on disk, so a stale shard or an old session never overrides a
+         * fresh take. Then our own takes, in case our manifest couldn't be written. A take
+         * whose latest record is flagged for overload is left out until it is re-rendered.
+         */
+        std::map<std::string, size_t> inPlan;
+        for (size_t i = 0; i < renderJobs.size(); ++i)
+            inPlan[sampleRelativePath(renderJobs[i]).generic_u8string()] = i;
+        std::map<std::string, Take> merged;
+        std::set<std::string> suspect;
+        for (const auto &r : rewrap::latestRecords(currentSampleDir))
+        {
+            auto p = inPlan.find(r.path);
+            if (p == inPlan.end())
+                continue;
+            auto job = renderJobs[p->second];
+            if (r.fingerprint != fingerprint(job, renderSettings))
+                continue;
+            if (r.flags & suspectTakeFlags)
+            {
+                suspect.insert(p->first);
+                continue;
+            }
+            auto t = r.toTake();
+            if (!fs::exists(currentSampleWavDir / t.relativePath))
+                continue;
+            t.job = job;
+            merged[p->first] = t;
+        }
+        for (const auto &t : completedTakes)
+            if (!suspect.count(t.relativePath.generic_u8string()))
+                merged.emplace(t.relativePath.generic_u8string(), t);
+        completedTakes.clear();
+        for (auto &[p, t] : merged)
+            completedTakes.push_back(t);
+        if (!suspect.empty())
+            pushMessage("Left out " + std::to_string(suspect.size()) +
+                        " takes flagged for overload; render again to replace them");
+
+        if (completedTakes.size() == renderJobs.size())
+        {
+            pushMessage("Merged all " + std::to_string(completedTakes.size()) + " shard takes");
+            fs::remove_all(currentSampleDir / "claims", ec);
+        }
+        else
+        {
+            pushMessage("Merged " + std::to_string(completedTakes.size()) + " of " +
+                        std::to_string(renderJobs.size()) +
+                        " takes. The last shard to finish writes the rest.");
+        }
+        sampleMultiFileEnd();
+        fs::remove(lock, ec);
+    }
+
+    void manifestAddCurrentJob(const RenderJob &job, const riffwav::RIFFWavWriter &rw,
+                               const manifest::TakeMetrics &takeMetrics, int64_t tailFrames,
+                               uint16_t flags)
+    {
+        manifest::TakeRecord r;
+        r.fromJob(job);
+        r.flags = flags;
+        r.sampleRate = currentSampleRate;
+        r.nChannels = rw.nChannels;
+        r.frameCount = rw.getSampleCount();
+        r.tailFrames = std::max(tailFrames, (int64_t)0);
+        r.peak = takeMetrics.peak;
+        r.rms = takeMetrics.rms(rw.nChannels);
+        r.hash = takeMetrics.hash;
+        r.dataOffset = rw.dataSizeLocation + 4;
+        r.fingerprint = fingerprint(job, renderSettings);
+        r.writtenAt = manifest::nowMicroseconds();
+        auto rel = rw.outPath.lexically_relative(currentSampleWavDir).generic_u8string();
+        strncpy(r.path, rel.c_str(), sizeof(r.path) - 1);
+        manifestWriter.push(r);
+    }
+
+    /*
+     * Live progress. As each take closes we fold how far it ran past its gate into a key and
+     * velocity model, predict the rest of the unfinished jobs from it, and scale that by the
+     * wall clock we've actually needed per recorded second so far (which captures the
+     * voices, latency and settle). All on the render thread; the UI reads progressPublished.
+     */
+    progress::KeyVelocityModel progressModel;
+    progress::Published progressPublished;
+    std::vector<uint8_t> progressJobDone;
+    progress::RemainingJobs progressRemaining;
+    std::chrono::steady_clock::time_point progressStartTime;
+    double progressRecordedSeconds{0};
+
+    void progressStart()
+    {
+        progressModel.reset();
+        progressJobDone = jobSkipped;
+        progressRemaining.reset();
+        const auto &renderJobs = writerPlan->jobs;
+        for (size_t i = 0; i < renderJobs.size(); ++i)
+        {
+            if (progressJobDone[i] || (queueSharding && jobClaims[i] == CLAIM_ELSEWHERE))
+                continue;
+            progressRemaining.add(renderJobs.gateSeconds[i], renderJobs.midiNote[i],
+                                  renderJobs.velocity[i]);
+        }
+        progressStartTime = std::chrono::steady_clock::now();
+        progressRecordedSeconds = 0;
+        progressPublished.jobsDone = 0;
+        progressPublished.jobsTotal =
+            std::count(jobSkipped.begin(), jobSkipped.end(), 0) - claimedElsewhere;
+        progressPublished.elapsedSeconds = 0;
+        progressPublished.etaSeconds = 0;
+        progressPublished.bytesWritten = 0;
+        progressPublished.running = true;
+    }
+
+    void progressTakeDone(int64_t jobIndex, const riffwav::RIFFWavWriter &rw)
+    {
+        const auto &renderJobs = writerPlan->jobs;
+        const auto &job = renderJobs[jobIndex];
+        auto recorded = 1.0 * rw.getSampleCount() / std::max(currentSampleRate, 1);
+        progressModel.add(job.midiNote, job.velocity, recorded - job.gateSeconds);
+        progressRecordedSeconds += recorded;
+        progressJobDone[jobIndex] = 1;
+        progressRemaining.remove(job.gateSeconds, job.midiNote, job.velocity);
+        auto remaining = progressRemaining.predictSeconds(progressModel);
+
+        auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                                     progressStartTime)
+                           .count();
+        auto wallPerRecorded = progressRecordedSeconds > 0 ? elapsed / progressRecordedSeconds : 1;
+        progressPublished.jobsDone++;
+        progressPublished.elapsedSeconds = elapsed;
+        progressPublished.bytesWritten = progressPublished.bytesWritten + rw.elementsWritten;
+        progressPublished.etaSeconds = remaining * wallPerRecorded;
+    }
+
+    /*
+     * Checkpoints for a coarse to fine render. As the takes close we count down the jobs
+     * left in each pass, and once every pass up to one is done rewrite the multi-file, with
+     * the takes stretched over the zones still to come. Not when sharded, since the other
+     * shards' takes are only gathered at the end. Only for the text formats, too: they are
+     * written on the render thread, and re-zipping or repacking every take so far would
+     * stall the drain of the io ring long enough for the audio thread to lap it.
+     */
+    bool checkpointsActive{false};
+    std::vector<int> checkpointRemaining;
+    int checkpointPass{0};
+
+    void checkpointStart()
+    {
+        const auto &renderJobs = writerPlan->jobs;
+        const auto &jobPasses = writerPlan->passes;
+        // only a coarse to fine plan has passes
+        checkpointsActive = renderLayout.shardMode == NO_SHARDS && !jobPasses.pass.empty() &&
+                            jobPasses.pass.size() == renderJobs.size();
+        if (checkpointsActive && multiFormat != SFZ && multiFormat != DECENT)
+        {
+            if (multiFormat != JUST_WAV)
+                pushMessage("Checkpoints are only written for SFZ and Decent. The multi-file "
+                            "is written once the render ends.");
+            checkpointsActive = false;
+        }
+        if (!checkpointsActive)
+            return;
+        checkpointRemaining.assign(jobPasses.nPasses, 0);
+        for (size_t i = 0; i < renderJobs.size(); ++i)
+            if (!jobSkipped[i])
+                checkpointRemaining[jobPasses.pass[i]]++;
+        checkpointPass = 0;
+        while (checkpointPass < jobPasses.nPasses && checkpointRemaining[checkpointPass] == 0)
+            checkpointPass++;
+    }
+
+    void checkpointTakeDone(int64_t jobIndex)
+    {
+        if (!checkpointsActive)
+            return;
+        const auto &jobPasses = writerPlan->passes;
+        checkpointRemaining[jobPasses.pass[jobIndex]]--;
+        auto before = checkpointPass;
+        while (checkpointPass < jobPasses.nPasses && checkpointRemaining[checkpointPass] <= 0)
+            checkpointPass++;
+        // the last pass is written by END_RENDER
+        if (checkpointPass == before || checkpointPass >= jobPasses.nPasses)
+            return;
+        pushMessage("Checkpoint after pass " + std::to_string(checkpointPass) + " of " +
+                    std::to_string(jobPasses.nPasses) + ", " +
+                    std::to_string(completedTakes.size()) + " takes");
+        sampleMultiFileEnd();
+    }
+
+    /*
+     * These write the multifile (SFZ, BWS, Descent, etc...). We collect the takes as they
+     * close and write the whole file at the end, so the writers can group and hoist.
+     */
+    void sampleMultiFileStart(bool clearTakes = true)
+    {
+        if (clearTakes)
+            completedTakes.clear();
+        switch (multiFormat)
+        {
+        case JUST_WAV:
+            pushMessage("Wav Files Only - no multi-sample format created");
+            break;
+        case SFZ:
+            pushMessage("MultiFile Format: SFZ");
+            pushMessage("   - '" + multiFilePath().filename().u8string() + "'");
+            break;
+        case DECENT:
+            pushMessage("MultiFile Format: Decent Sampler");
+            pushMessage("   - '" + multiFilePath().filename().u8string() + "'");
+            break;
         case MULTISAMPLE:
+            pushMessage("MultiFile Format: MultiSample");
+            pushMessage("   - '" + multiFilePath().filename().u8string() + "'");
+            break;
+        case SF2:
+            pushMessage(std::string("MultiFile Format: SF2 ") +
+                        (renderLayout.sf2TwentyFourBit ? "24 bit" : "16 bit"));
+            pushMessage("   - '" + multiFilePath().filename().u8string() + "'");
+            break;
+        }
+    }
+
+    fs::path multiFilePath()
+    {
+        auto bn = currentSampleDir.filename().replace_extension();
+        switch (multiFormat)
         {
-            if (!multiFile.is_open())
-                return;
-            multiFile << "    <sample file=\"" << fn.filename().u8string() << "\" ";
-            if (currentJob.roundRobinOutOf > 1)
-                multiFile << " zone-logic=\"round-robin\" ";
-            multiFile << " sample-start=\"0\" sample-stop=\"" << rw.getSampleCount() << "\" ";
-            multiFile << ">\n";
-
-            multiFile << "         <key "
-                      << "low=\"" << currentJob.noteFrom << "\" "
-                      << "high=\"" << currentJob.noteTo << "\" "
-                      << "root=\"" << currentJob.midiNote << "\" "
-                      << "/>\n";
-            multiFile << "         <velocity "
-                      << "low=\"" << currentJob.velFrom << "\" "
-                      << "high=\"" << currentJob.velTo << "\"/>\n";
-
-            multiFile << "    </sample>\n";
+        case SFZ:
+            return (currentSampleDir / bn.u8string()).replace_extension("sfz");
+        case DECENT:
+            return (currentSampleDir / bn.u8string()).replace_extension("dspreset");
+        case MULTISAMPLE:
+            return currentSampleWavDir / "multisample.xml";
+        case SF2:
+            return (currentSampleDir / bn.u8string()).replace_extension("sf2");
+        default:
+            break;
+        }
+        return {};
+    }
+
+    void sampleMultiFileEnd()
+    {
+        // a coarse to fine render stopped part way still leaves a playable multi-file
+        std::vector<Take> stretched;
+        if (checkpointsActive)
+            stretched = progressive::stretchToPlan(completedTakes, writerPlan->jobs);
+        const auto &takes = checkpointsActive ? stretched : completedTakes;
+
+        auto fn = multiFilePath();
+        // sample paths in the sfz and dspreset are relative to the file in the sample dir
+        auto prefix = currentSampleWavDir.filename().u8string() + "/";
+        bool ok{true};
+
+        switch (multiFormat)
+        {
+        case JUST_WAV:
+            return;
+        case SFZ:
+            ok = multifile::writeSFZ(fn, prefix, takes);
+            pushMessage("Closing SFZ File");
+            break;
+        case DECENT:
+            ok = multifile::writeDecent(fn, prefix, takes);
+            pushMessage("Closing .dspreset File");
+            break;
+        case MULTISAMPLE:
+        {
+            auto nm = currentSampleDir.filename().replace_extension();
+            ok = multifile::writeMultiSample(fn, nm.u8string(), takes);
+            pushMessage("Closing multisample.xml File");
+            if (ok)
+            {
+                auto zf = (currentSampleDir / currentSampleDir.filename())
+                              .replace_extension(".multisample");
+
+                pushMessage("Creating zip : " + zf.u8string());
+                ziparchive::zipDirToOutputFrom(zf, currentSampleWavDir);
+            }
+        }
+        break;
+        case SF2:
+        {
+            pushMessage("Packing SF2 File");
+            auto nm = currentSampleDir.filename().replace_extension();
+            sf2::SF2Writer sf2w(fn, renderLayout.sf2TwentyFourBit);
+            ok = sf2w.write(nm.u8string(), currentSampleWavDir, takes);
+            if (!ok)
+                pushError(sf2w.errMsg);
+            else if (!takes.empty() && takes[0].job.roundRobinOutOf > 1)
+                pushMessage("   - SF2 has no round robin; only the first was packed");
         }
         break;
+        }
+
+        if (!ok)
+        {
+            pushError("Failed to write output MultiFile '" + fn.filename().u8string() + "'");
+        }
+    }
+
+    // A re-recorded take replaces the one at its path rather than adding a second
+    void sampleMultiFileAddCurrentJob(const RenderJob &currentJob, const riffwav::RIFFWavWriter &rw,
+                                      bool replace = false)
+    {
+        auto rel = rw.outPath.lexically_relative(currentSampleWavDir);
+        if (replace)
+        {
+            for (auto &t : completedTakes)
+            {
+                if (t.relativePath == rel)
+                {
+                    t = {currentJob, rel, rw.getSampleCount()};
+                    return;
+                }
+            }
+        }
+        completedTakes.push_back({currentJob, rel, rw.getSampleCount()});
+    }
+
+    /*
+     * The parameters which shape the job list. Usually read from the knobs, but the budget
+     * solver builds plans from variations of them, and the preview builds them on its own
+     * thread, so they carry their own copy of the curves and seed.
+     */
+    struct PlanParameters
+    {
+        int numVel{1}, numRR{1}, midiStep{12};
+        int midiStart{48}, midiEnd{72};
+        int velStrategy{1}, rrOneStrategy{0}, rrTwoStrategy{1};
+        float gateTime{1.f};
+        float maxTailSeconds{0.f};
+        uint32_t rrSeed{0};
+        curve::BreakpointCurve gateKeyCurve, gateVelocityCurve, tailKeyCurve, tailVelocityCurve;
+        std::vector<int> keyNotes; // adaptive sample notes; empty for the uniform midi step
+        std::vector<int> velocityLayers; // adaptive sample velocities; empty for the curve
+
+        bool operator==(const PlanParameters &o) const
+        {
+            return numVel == o.numVel && numRR == o.numRR && midiStep == o.midiStep &&
+                   midiStart == o.midiStart && midiEnd == o.midiEnd &&
+                   velStrategy == o.velStrategy && rrOneStrategy == o.rrOneStrategy &&
+                   rrTwoStrategy == o.rrTwoStrategy && gateTime == o.gateTime &&
+                   maxTailSeconds == o.maxTailSeconds && rrSeed == o.rrSeed &&
+                   gateKeyCurve == o.gateKeyCurve && gateVelocityCurve == o.gateVelocityCurve &&
+                   tailKeyCurve == o.tailKeyCurve && tailVelocityCurve == o.tailVelocityCurve &&
+                   keyNotes == o.keyNotes && velocityLayers == o.velocityLayers;
+        }
+        bool operator!=(const PlanParameters &o) const { return !(*this == o); }
+
+        // Everything but the note range, which only decides which columns there are
+        PlanParameters layerSettings() const
+        {
+            auto res = *this;
+            res.midiStep = 0;
+            res.midiStart = 0;
+            res.midiEnd = 0;
+            res.keyNotes.clear();
+            return res;
+        }
+    };
+
+    PlanParameters planParametersFromParams()
+    {
+        PlanParameters pp;
+        pp.numVel = (int)std::round(getParam(NUM_VEL_LAYERS).getValue());
+        pp.numRR = (int)std::round(getParam(NUM_ROUND_ROBINS).getValue());
+        pp.midiStep = (int)std::round(getParam(MIDI_STEP_SIZE).getValue());
+        pp.midiStart = (int)std::round(getParam(MIDI_START_RANGE).getValue());
+        pp.midiEnd = (int)std::round(getParam(MIDI_END_RANGE).getValue());
+        pp.velStrategy = (int)std::round(getParam(VELOCITY_STRATEGY).getValue());
+        pp.rrOneStrategy = (int)std::round(getParam(RR1_TYPE).getValue());
+        pp.rrTwoStrategy = (int)std::round(getParam(RR2_TYPE).getValue());
+        pp.gateTime = getParam(GATE_TIME).getValue();
+        pp.maxTailSeconds = maxTailSeconds;
+        pp.rrSeed = rrSeed;
+        pp.gateKeyCurve = *std::atomic_load(&gateKeyCurve);
+        pp.gateVelocityCurve = *std::atomic_load(&gateVelocityCurve);
+        pp.tailKeyCurve = *std::atomic_load(&tailKeyCurve);
+        pp.tailVelocityCurve = *std::atomic_load(&tailVelocityCurve);
+        if (auto kn = std::atomic_load(&adaptiveKeyNotes))
+            pp.keyNotes = *kn;
+        if (auto vl = std::atomic_load(&adaptiveVelocityLayers))
+            pp.velocityLayers = *vl;
+        return pp;
+    }
+
+    void populateRenderJobs(JobTable &onto)
+    {
+        populateRenderJobs(onto, planParametersFromParams());
+    }
+
+    /*
+     * Test and Start build the render's plan here on the UI thread and publish it, so the
+     * audio thread never builds the job table, the order or the passes inside process().
+     * It picks the plan up with atomic_load as the render starts.
+     */
+    PlanPtr startPlan;
+
+    void requestStart(bool test)
+    {
+        if (createState != INACTIVE)
+            return;
+        auto snap = std::make_shared<PlanSnapshot>();
+        snap->nVoices = std::clamp((int)std::round(getParam(POLYPHONY).getValue()), 1, maxVoices);
+        populateRenderJobs(snap->jobs);
+        populateJobOrder(*snap);
+        std::atomic_store(&startPlan, plans.publish(std::move(snap)));
+        testMode = test;
+        startOperating = true;
+    }
+
+    /*
+     * The plan the keyboard shows. While a render runs that is the render's, whatever the
+     * knobs have previewed since, so currentJobIndex and the voice jobs index the right one.
+     */
+    PlanPtr shownPlan() const
+    {
+        auto cs = createState;
+        if (cs != INACTIVE && cs != CALIBRATING && cs != PROBING)
+            if (auto sp = std::atomic_load(&startPlan))
+                return sp;
+        return plans.load();
+    }
+
+    /*
+     * The keyboard preview. The widget asks for a plan whenever the parameters differ from
+     * the last it asked for, and planWorker builds it off the UI thread, reusing the columns
+     * of the previous preview it can, and publishes it for the keyboard to pick up by
+     * version. Test and Start publish the render's own (see requestStart).
+     */
+    using previewColumns_t = planworker::ColumnCache<PlanParameters>;
+    previewColumns_t previewColumns; // only used on the plan worker thread
+    planworker::DebouncedWorker<PlanParameters> planWorker{
+        [this](const auto &pp) { buildPreviewPlan(pp); }, std::chrono::milliseconds(60),
+        std::chrono::milliseconds(250)};
+
+    void requestPreviewPlan(const PlanParameters &pp) { planWorker.request(pp); }
+
+    void buildPreviewPlan(const PlanParameters &pp)
+    {
+        auto snap = std::make_shared<PlanSnapshot>();
+        populateRenderJobs(snap->jobs, pp, &previewColumns);
+        plans.publish(std::move(snap));
+    }
+
+    void populateRenderJobs(JobTable &onto, const PlanParameters &pp,
+                            previewColumns_t *cache = nullptr)
+    {
+        onto.clear();
+        auto numVel = pp.numVel;
+        auto numRR = pp.numRR;
+        auto midiStep = std::max(pp.midiStep, 1);
+        auto midiHalf = midiStep <= 2 ? 0 : midiStep / 2;
+
+        auto midiStart = pp.midiStart;
+        auto midiEnd = pp.midiEnd;
+
+        if (midiStart > midiEnd)
+            std::swap(midiStart, midiEnd);
+
+        std::vector<planworker::NoteColumn> columns;
+        if (!pp.keyNotes.empty())
+            adaptiveKeyColumns(columns, pp.keyNotes, midiStart, midiEnd);
+        if (columns.empty())
+        {
+            auto numSteps = (int)std::ceil(1.f * (midiEnd - midiStart + 1) / midiStep);
+            auto coverDiff = numSteps * midiStep - (midiEnd - midiStart);
+            for (int i = 0; i < numSteps; ++i)
+            {
+                auto mn = i * midiStep + midiHalf + midiStart - coverDiff / 2;
+                auto nf = mn - midiHalf;
+                auto nt = nf + midiStep - 1;
+
+                nf = std::clamp(nf, midiStart, midiEnd);
+                nt = std::clamp(nt, midiStart, midiEnd);
+                mn = std::clamp((nf + nt) / 2, midiStart, midiEnd);
+                columns.push_back({mn, nf, nt});
+            }
+        }
+
+        onto.reserve(columns.size() * numVel * numRR);
+        if (cache)
+            cache->beginPlan(pp.layerSettings());
+        for (const auto &col : columns)
+        {
+            if (cache)
+                cache->appendColumn(onto, col, [&pp, this](auto &c, const auto &nc) {
+                    populateNoteColumn(c, nc, pp);
+                });
+            else
+                populateNoteColumn(onto, col, pp);
+        }
+        if (cache)
+            cache->endPlan();
+    }
+
+    // Zones from adaptive sample notes meet halfway between them, and the outer ones reach
+    // the ends of the range. Notes outside the range are dropped.
+    static void adaptiveKeyColumns(std::vector<planworker::NoteColumn> &onto,
+                                   const std::vector<int> &notes, int midiStart, int midiEnd)
+    {
+        std::vector<int> in;
+        for (auto n : notes)
+            if (n >= midiStart && n <= midiEnd && (in.empty() || n > in.back()))
+                in.push_back(n);
+        for (size_t i = 0; i < in.size(); ++i)
+        {
+            auto nf = i == 0 ? midiStart : (in[i - 1] + in[i]) / 2 + 1;
+            auto nt = i + 1 == in.size() ? midiEnd : (in[i] + in[i + 1]) / 2;
+            onto.push_back({in[i], nf, nt});
+        }
+    }
+
+    // The velocity layers and round robins of one note, which depend only on its notes and
+    // the layer settings
+    void populateNoteColumn(JobTable &onto, const planworker::NoteColumn &col,
+                            const PlanParameters &pp) const
+    {
+        auto numVel = pp.numVel;
+        auto numRR = pp.numRR;
+        auto velStrategy = pp.velStrategy;
+
+        auto gateTime = pp.gateTime;
+
+        auto rrOneStrategy = pp.rrOneStrategy;
+        auto rrTwoStrategy = pp.rrTwoStrategy;
+
+        auto mn = col.midiNote;
+        const auto &adaptiveVel = pp.velocityLayers;
+        if (!adaptiveVel.empty())
+            numVel = (int)adaptiveVel.size();
+        auto dVel = 1.0 / (numVel);
+
+        RenderJob mrj;
+        mrj.midiNote = mn;
+        mrj.noteFrom = col.noteFrom;
+        mrj.noteTo = col.noteTo;
+
+        int lastVelTo{0};
+        for (int vl = 0; vl < numVel; ++vl)
+        {
+            int mv, msv, mev;
+            if (!adaptiveVel.empty())
+            {
+                // adaptive layers meet halfway between their velocities, like key zones
+                mv = adaptiveVel[vl];
+                msv = vl == 0 ? 1 : (adaptiveVel[vl - 1] + mv) / 2 + 1;
+                mev = vl + 1 == numVel ? 127 : (mv + adaptiveVel[vl + 1]) / 2;
+            }
+            else
+            {
+                auto bv = (vl + 0.5) * dVel;
+                auto sv = vl * dVel;
+                auto ev = (vl + 1) * dVel;
+
+                std::function<double(double)> fn = [](double x) { return x; };
+                if (velStrategy == 1)
+                    fn = [](double x) { return sqrt(x); };
+                if (velStrategy == 2)
+                    fn = [](double x) { return x * x; };
+
+                mv = (int)std::round(std::clamp(fn(bv), 0., 1.) * 128);
+                msv = (int)std::round(std::clamp(fn(sv), 0., 1.) * 128);
+                mev = (int)std::round(std::clamp(fn(ev), 0., 1.) * 128) - 1;
+            }
+            msv = std::clamp(std::max(msv, lastVelTo + 1), 1, 127);
+            mev = std::clamp(mev, 1, 127); // we can't use 0 since thats 'off'
+            // with many layers a curved strategy can round some of them to nothing
+            if (mev < msv)
+                continue;
+            lastVelTo = mev;
+            mv = std::clamp(mv, msv, mev);
+
+            auto vrj = mrj;
+            vrj.velocity = mv;
+            vrj.velFrom = msv;
+            vrj.velTo = mev;
+            vrj.gateSeconds = std::clamp(gateTime * pp.gateKeyCurve.valueAt(mn) *
+                                             pp.gateVelocityCurve.valueAt(mv),
+                                         0.001f, 64.f);
+            vrj.maxTailSeconds = std::clamp(pp.maxTailSeconds * pp.tailKeyCurve.valueAt(mn) *
+                                                pp.tailVelocityCurve.valueAt(mv),
+                                            0.f, 3600.f);
+
+            for (int rr = 0; rr < numRR; ++rr)
+            {
+                auto rj = vrj;
+                rj.roundRobinIndex = rr;
+                rj.roundRobinOutOf = numRR;
+                auto reng = engineForJob(rj, pp.rrSeed);
+                std::uniform_real_distribution<float> uniReal{0.f, 1.f};
+                switch (rrOneStrategy)
+                {
+                case 2: // index
+                    rj.rrRand[0] = (numRR == 1 ? 0 : 10.f * rr / (numRR - 1));
+                    break;
+                case 1: // pm5v
+                    rj.rrRand[0] = uniReal(reng) * 10.f - 5.f;
+                    break;
+                default:
+                case 0: // 0-10v
+                    rj.rrRand[0] = uniReal(reng) * 10.f;
+                    break;
+                }
+                switch (rrTwoStrategy)
+                {
+                case 2: // index
+                    rj.rrRand[1] = (numRR == 1 ? 0 : 10.f * rr / (numRR - 1));
+                    break;
+                case 1: // pm5v
+                    rj.rrRand[1] = uniReal(reng) * 10.f - 5.f;
+                    break;
+                default:
+                case 0: // 0-10v
+                    rj.rrRand[1] = uniReal(reng) * 10.f;
+                    break;
+                }
+                onto.push_back(rj);
+            }
+        }
+    }
+
+    /*
+     * Estimates for the plan the knobs describe, and the budget solver, shown in the status
+     * area while idle. Both build whole plans, the solver dozens of them, so the UI gathers
+     * what they depend on into an EstimateRequest and estimateWorker runs it off the UI
+     * thread, publishing the lines to show as estimateResult.
+     */
+    float engineSampleRate{48000.f};
+    void onSampleRateChange(const SampleRateChangeEvent &e) override
+    {
+        engineSampleRate = e.sampleRate;
+    }
+
+    float expectedTailSeconds{2.f};
+    float budgetMB{0.f};      // 0 for no budget
+    float budgetMinutes{0.f}; // 0 for no budget
+
+    struct FormatCost
+    {
+        std::string name;
+        float extraBytesPerSample{0.f};
+        bool firstRROnly{false};
+    };
+    FormatCost formatCost(MultiFormats f) const
+    {
+        switch (f)
+        {
+        case SF2:
+            return {sf2TwentyFourBit ? "SF2 24 bit" : "SF2 16 bit",
+                    sf2TwentyFourBit ? 3.f : 2.f, true};
+        case MULTISAMPLE:
+            return {"MultiSample", 4.f, false}; // the zip holds a second copy of the wavs
+        case SFZ:
+            return {"SFZ", 0.f, false};
+        case DECENT:
+            return {"Decent", 0.f, false};
+        case JUST_WAV:
         default:
             break;
         }
+        return {"Just WAV", 0.f, false};
+    }
+
+    estimate::EstimateSettings estimateSettings(const FormatCost &fc)
+    {
+        estimate::EstimateSettings es;
+        es.sampleRate = (int)engineSampleRate;
+        es.nChannels = inputs[INPUT_R].isConnected() ? 2 : 1;
+        auto poly = std::clamp((int)std::round(getParam(POLYPHONY).getValue()), 1, maxVoices);
+        es.nVoices = maxOverlap == 0 ? poly : std::min(maxOverlap, poly);
+        es.lockstep = scheduling == LOCKSTEP;
+        es.latencySeconds = getParam(LATENCY_COMPENSATION).getValue() / engineSampleRate;
+        es.expectedTailSeconds = expectedTailSeconds;
+        auto rm = (int)std::round(getParam(REL_MODE).getValue());
+        es.spindownSeconds = (adaptiveSettle ? minSettleSamples
+                                             : spindownLength * (rm == GATEONLY ? 16 : 1)) /
+                             engineSampleRate;
+        if (rm == GATEONLY)
+            es.expectedTailSeconds = 1.f * gateOnlyFadeLength / engineSampleRate;
+        es.extraBytesPerSample = fc.extraBytesPerSample;
+        es.extraFirstRROnly = fc.firstRROnly;
+        return es;
+    }
+
+    MultiFormats formatFromParam()
+    {
+        auto iv = (int)std::round(getParam(OUTPUT_FORMAT).getValue());
+        return (iv < JUST_WAV || iv > SF2) ? JUST_WAV : (MultiFormats)iv;
+    }
+
+    struct EstimateCandidate
+    {
+        FormatCost cost;
+        estimate::EstimateSettings settings;
+    };
+    struct EstimateRequest
+    {
+        PlanParameters pp;
+        selection::JobSelection selection;
+        std::vector<EstimateCandidate> formats; // the current format first
+        float budgetMB{0.f}, budgetMinutes{0.f};
+    };
+    struct EstimateResult
+    {
+        std::string line, budget;
+    };
+    std::shared_ptr<const EstimateResult> estimateResult; // atomic_store and atomic_load
+    planworker::DebouncedWorker<EstimateRequest> estimateWorker{
+        [this](const auto &r) { runEstimate(r); }, std::chrono::milliseconds(60),
+        std::chrono::milliseconds(250)};
+
+    // On the UI thread, which owns the knobs, the menu settings and the selection
+    void requestEstimate()
+    {
+        EstimateRequest r;
+        r.pp = planParametersFromParams();
+        r.selection = *currentJobSelection();
+        auto curFmt = formatFromParam();
+        r.formats.push_back({formatCost(curFmt), estimateSettings(formatCost(curFmt))});
+        if (formatCost(curFmt).extraBytesPerSample > 0)
+            r.formats.push_back({formatCost(SFZ), estimateSettings(formatCost(SFZ))});
+        r.budgetMB = budgetMB;
+        r.budgetMinutes = budgetMinutes;
+        estimateWorker.request(r);
+    }
+
+    void runEstimate(const EstimateRequest &r)
+    {
+        JobTable jobs;
+        populateRenderJobs(jobs, r.pp);
+        if (!r.selection.empty())
+            jobs.retainIf([&r](const auto &j) { return r.selection.matches(j); });
+        auto e = estimate::estimatePlan(jobs, r.formats.front().settings);
+
+        auto res = std::make_shared<EstimateResult>();
+        res->line = "~" + estimate::formatDuration(e.seconds) + "  " +
+                    estimate::formatBytes(e.bytes);
+        if (r.budgetMB > 0 || r.budgetMinutes > 0)
+            res->budget = withinBudget(r, e) ? "Within budget" : solveForBudget(r);
+        std::atomic_store(&estimateResult, std::shared_ptr<const EstimateResult>(res));
+    }
+
+    static bool withinBudget(const EstimateRequest &r, const estimate::PlanEstimate &e)
+    {
+        return (r.budgetMB <= 0 || e.bytes <= r.budgetMB * 1024.0 * 1024.0) &&
+               (r.budgetMinutes <= 0 || e.seconds <= r.budgetMinutes * 60.0);
+    }
+
+    /*
+     * Search note step, velocity layers and output format for the plan with the most zones
+     * which fits the budget, preferring the current format and then the quicker render.
+     */
+    std::string solveForBudget(const EstimateRequest &r)
+    {
+        if (r.budgetMB <= 0 && r.budgetMinutes <= 0)
+            return "";
+
+        const auto &base = r.pp;
+        const auto &formats = r.formats;
+
+        struct Best
+        {
+            bool found{false};
+            int zones{0};
+            size_t fmtIdx{0};
+            double seconds{0};
+            PlanParameters pp;
+        } best;
+
+        // adaptive key zones fix the notes, so only the layers and format are free
+        std::vector<int> steps{1, 2, 3, 4, 6, 12};
+        if (!base.keyNotes.empty())
+            steps = {base.midiStep};
+
+        JobTable jobs;
+        for (size_t fi = 0; fi < formats.size(); ++fi)
+        {
+            const auto &es = formats[fi].settings;
+            for (auto step : steps)
+            {
+                /*
+                 * More layers only ever costs more, so bisect for the most which fit
+                 * rather than trying each of up to 127 in turn
+                 */
+                auto pp = base;
+                pp.midiStep = step;
+                int lo{1}, hi{base.velocityLayers.empty() ? base.numVel : 1}, fits{0};
+                estimate::PlanEstimate fitE;
+                while (lo <= hi)
+                {
+                    pp.numVel = (lo + hi) / 2;
+                    populateRenderJobs(jobs, pp);
+                    auto e = estimate::estimatePlan(jobs, es);
+                    if (withinBudget(r, e))
+                    {
+                        fits = pp.numVel;
+                        fitE = e;
+                        lo = pp.numVel + 1;
+                    }
+                    else
+                    {
+                        hi = pp.numVel - 1;
+                    }
+                }
+                if (fits == 0)
+                    continue;
+
+                pp.numVel = fits;
+                auto zones = (int)(fitE.jobs / std::max(pp.numRR, 1));
+                auto better = !best.found || zones > best.zones ||
+                              (zones == best.zones && fi < best.fmtIdx) ||
+                              (zones == best.zones && fi == best.fmtIdx &&
+                               fitE.seconds < best.seconds);
+                if (better)
+                    best = {true, zones, fi, fitE.seconds, pp};
+            }
+        }
+
+        if (!best.found)
+            return "Nothing fits budget";
+        auto keys = best.pp.keyNotes.empty() ? "step " + std::to_string(best.pp.midiStep)
+                                             : std::string("adaptive keys");
+        auto layers = best.pp.velocityLayers.empty() ? best.pp.numVel
+                                                     : (int)best.pp.velocityLayers.size();
+        return "Budget: " + keys + ", " + std::to_string(layers) + " layers, " +
+               formats[best.fmtIdx].cost.name;
+    }
+
+    void setupOutputFormatAndDirectories()
+    {
+        multiFormat = formatFromParam();
+
+        if (currentSampleDir.empty())
+            currentSampleDir = fs::path{rack::asset::userDir} / "SampleCreator" / "Default";
+        currentSampleWavDir = currentSampleDir / "wav";
+
+        if (multiFormat == MULTISAMPLE)
+        {
+            currentSampleWavDir = currentSampleDir / "raw";
+        }
+    }
+
+    /*
+     * Rebuild the multi-file for the current output format from the wav files already in the
+     * output directory, without recording anything. Runs on the render thread while idle.
+     */
+    std::atomic<bool> rewrapRequested{false};
+    void renderThreadRewrap()
+    {
+        renderLayout = outputLayoutFromSettings();
+        setupOutputFormatAndDirectories();
+        if (!fs::is_directory(currentSampleWavDir))
+        {
+            // a render into another format leaves its samples in the other directory
+            auto other = currentSampleDir / (multiFormat == MULTISAMPLE ? "wav" : "raw");
+            if (fs::is_directory(other))
+                currentSampleWavDir = other;
+        }
+
+        pushMessage("Rewrapping samples in '" + currentSampleWavDir.u8string() + "'");
+        auto st = std::chrono::steady_clock::now();
+
+        std::vector<std::string> errors;
+        size_t listed{0};
+        completedTakes = rewrap::findTakes(currentSampleDir, currentSampleWavDir, errors, listed);
+        if (listed > 0)
+            pushMessage("Took " + std::to_string(listed) + " of " +
+                        std::to_string(completedTakes.size()) + " takes from the manifests");
+        for (const auto &e : errors)
+            pushError(e);
+        if (completedTakes.empty())
+        {
+            pushError("No samples found to rewrap");
+            return;
+        }
+
+        pushMessage("Found " + std::to_string(completedTakes.size()) + " samples");
+        sampleMultiFileStart(false);
+        sampleMultiFileEnd();
+
+        auto el = std::chrono::duration<double>(std::chrono::steady_clock::now() - st).count();
+        pushMessage("Rewrap complete in " + std::to_string(el) + "s");
+    }
+
+    void process(const ProcessArgs &args) override
+    {
+        if (createState == INACTIVE && startOperating && !rewrapRequested && !renderEnding)
+        {
+            pushStatus(testMode ? "Test" : "Record", 0);
+            pushStatus("Start", 1);
+            pushMessage(std::string("Starting render in ") +
+                        (testMode ? "Test Mode" : "Record Mode"));
+            startOperating = false;
+            createState = NEW_NOTE;
+            currentJobIndex = -1;
+            nextJobIndex = 0;
+            latencyInitValue = std::round(getParam(LATENCY_COMPENSATION).getValue());
+            releaseMode = (ReleaseMode)std::round(getParam(REL_MODE).getValue());
+            renderSettings.gateTime = getParam(GATE_TIME).getValue();
+            renderSettings.releaseMode = releaseMode;
+            renderSettings.latency = latencyInitValue;
+            renderSettings.sampleRate = (int)args.sampleRate;
+            renderSettings.nChannels = inputs[INPUT_R].isConnected() ? 2 : 1;
+            renderLayout = outputLayoutFromSettings();
+            silenceSettings.holdSamples = std::ceil(args.sampleRate * silenceHoldMs / 1000.f);
+            renderSettings.silenceMode = silenceSettings.mode;
+            renderSettings.silenceThresholdDb = silenceSettings.thresholdDb;
+            renderSettings.silenceHoldMs = silenceHoldMs;
+            renderSettings.maxTailSeconds = maxTailSeconds;
+            renderSettings.trimLeadingSilence = trimLeadingSilence;
+            renderSettings.adaptiveGate = adaptiveGate;
+            renderSettings.adaptiveGateMinSeconds = adaptiveGateMinSeconds;
+            renderSettings.adaptiveGateHoldSeconds = adaptiveGateHoldSeconds;
+            adaptiveGateMinSamples = std::ceil(args.sampleRate * adaptiveGateMinSeconds);
+            adaptiveGateHoldSamples = std::ceil(args.sampleRate * adaptiveGateHoldSeconds);
+            onsetThreshold = std::pow(10.f, silenceSettings.thresholdDb / 20.f);
+            audioPlan = std::atomic_load(&startPlan);
+            nVoices = audioPlan->nVoices;
+            warnedInputChannels = false;
+            for (auto &vc : voices)
+            {
+                vc.settle.reset(settleSettings());
+                vc.idleSamples = 0;
+            }
+
+            setupOutputFormatAndDirectories();
+
+            if (!testMode)
+            {
+                try
+                {
+                    fs::create_directories(currentSampleDir);
+                    fs::create_directories(currentSampleWavDir);
+                    pushMessage("Output to '" + currentSampleDir.u8string() + "'");
+                }
+                catch (const fs::filesystem_error &e)
+                {
+                    pushError(std::string() + "Unable to create output directories : " + e.what());
+                }
+            }
+
+            std::atomic_store(&writerPlanHandoff, audioPlan);
+            const auto &renderJobs = audioPlan->jobs;
+
+            jobSkipped.assign(renderJobs.size(), 0);
+            retryQueue.clear();
+            retryQueue.reserve(renderJobs.size() * overloadRetries);
+            retryNext = 0;
+            retryCount.assign(renderJobs.size(), 0);
+            lagClock.reset(args.sampleRate);
+            auto sel = currentJobSelection();
+            renderingSelection = !sel->empty();
+            if (renderingSelection)
+            {
+                for (size_t i = 0; i < renderJobs.size(); ++i)
+                    if (!sel->matches(renderJobs[i]))
+                        jobSkipped[i] = 3;
+                pushMessage("Rendering " +
+                            std::to_string(std::count(jobSkipped.begin(), jobSkipped.end(), 0)) +
+                            " selected jobs");
+            }
+            shardAssignJobs();
+            existingScanComplete = false;
+            renderThreadCommands.push(RenderThreadCommand{RenderThreadCommand::START_RENDER});
+            pushMessage(std::string("Generated render jobs: " + std::to_string(renderJobs.size()) +
+                                    " renders"));
+            if (nVoices > 1)
+                pushMessage("Rendering " + std::to_string(nVoices) + " voices in parallel");
+            clearVU();
+        }
+
+        if (createState == INACTIVE && calibrateRequested && !startOperating && !rewrapRequested)
+        {
+            calibrationStart();
+        }
+
+        if (createState == CALIBRATING)
+        {
+            calibrationProcess(args.sampleRate);
+            return;
+        }
+
+        if (createState == INACTIVE && probeRequested && !startOperating && !rewrapRequested)
+        {
+            probeStart();
+        }
+
+        if (createState == PROBING)
+        {
+            probeProcess();
+            return;
+        }
+
+        if (createState == INACTIVE)
+        {
+            for (auto o : {OUTPUT_VOCT, OUTPUT_GATE, OUTPUT_VELOCITY, OUTPUT_RR_ONE, OUTPUT_RR_TWO})
+                outputs[o].setChannels(1);
+            outputs[OUTPUT_VOCT].setVoltage(0.f);
+            outputs[OUTPUT_GATE].setVoltage(0.f);
+            clearVU();
+            return;
+        }
+
+        if (createState == NEW_NOTE || createState == RECORDING ||
+            createState == SPINDOWN_BUFFER)
+        {
+            if (lagClock.step())
+                for (int v = 0; v < nVoices; ++v)
+                    if (voices[v].state != INACTIVE)
+                        voices[v].timing.windowDone(lagClock.windowFloor);
+        }
+
+        if (stopImmediately)
+        {
+            pushMessage("Stopping operation");
+            clearVU();
+
+            for (int v = 0; v < nVoices; ++v)
+            {
+                if (voices[v].state != INACTIVE)
+                    voiceFinish(v, 0, true);
+                outputs[OUTPUT_GATE].setVoltage(0.f, v);
+            }
+            if (!testMode)
+            {
+                pushEndRender();
+            }
+            createState = INACTIVE;
+            currentJobIndex = -1;
+            clearVU();
+            pushIdle();
+            stopImmediately = false;
+            return;
+        }
+
+        if (createState == NEW_NOTE && !existingScanComplete)
+        {
+            outputs[OUTPUT_GATE].setVoltage(0.f);
+            return;
+        }
+
+        if (createState == NEW_NOTE)
+        {
+            for (auto o : {OUTPUT_VOCT, OUTPUT_GATE, OUTPUT_VELOCITY, OUTPUT_RR_ONE, OUTPUT_RR_TWO})
+                outputs[o].setChannels(nVoices);
+
+            bool started{false};
+            for (int v = 0; v < std::min(nVoices, overlapLimit()); ++v)
+                started = startNextJob(v, args.sampleRate) || started;
+            if (!started)
+            {
+                // wait for the render thread to claim the next job from a shared queue
+                if (nextJobIndex < (int64_t)audioPlan->order.size())
+                    return;
+                // everything was already on disk or in another shard
+                endRender();
+                return;
+            }
+            createState = RECORDING;
+        }
+
+        if (createState == RECORDING)
+        {
+            bool anyActive{false};
+            int nActive{0};
+            for (int v = 0; v < nVoices; ++v)
+            {
+                voiceProcess(v);
+                nActive += voices[v].state != INACTIVE;
+            }
+
+            if (scheduling == OVERLAPPED)
+            {
+                for (int v = 0; v < nVoices; ++v)
+                {
+                    auto &vc = voices[v];
+                    if (vc.state != INACTIVE)
+                        continue;
+                    vc.idleSamples++;
+                    auto quiet = vc.settle.process(inputs[INPUT_L].getPolyVoltage(v) / 5.f,
+                                                   inputs[INPUT_R].getPolyVoltage(v) / 5.f);
+                    if (settleDone(quiet, vc.idleSamples) && nActive < overlapLimit() &&
+                        startNextJob(v, args.sampleRate))
+                    {
+                        nActive++;
+                    }
+                }
+            }
+            anyActive = nActive > 0;
+
+            if (!anyActive)
+            {
+                clearVU();
+                createState = SPINDOWN_BUFFER;
+                playbackPos = 0;
+                settleDetector.reset(settleSettings());
+            }
+        }
+
+        bool settleQuiet{false};
+        if (createState == SPINDOWN_BUFFER)
+        {
+            float mx{0};
+            for (int v = 0; v < nVoices; ++v)
+                mx = std::max({mx, std::fabs(inputs[INPUT_L].getPolyVoltage(v)),
+                               std::fabs(inputs[INPUT_R].getPolyVoltage(v))});
+            settleQuiet = settleDetector.process(mx / 5.f, 0.f);
+        }
+
+        if (createState == SPINDOWN_BUFFER && settleDone(settleQuiet, playbackPos))
+        {
+            if (!jobsRemaining())
+            {
+                endRender();
+            }
+            else
+            {
+                createState = NEW_NOTE;
+            }
+        }
+
+        playbackPos++;
+    }
+
+    /*
+     * Latency calibration plays one full velocity note in the middle of the range and
+     * counts the frames from the gate edge to the first one above calibrationThresholdDb.
+     * That onset (less a small safety margin, so we never cut into an attack) becomes the
+     * latency compensation. We then wait for the tail to go silent so the next render
+     * starts clean.
+     */
+    static constexpr float calibrationThresholdDb{-60.f};
+    static constexpr int calibrationMargin{16};
+    static constexpr float calibrationGateSeconds{0.25f};
+    uint64_t calibrationPos{0};
+    int64_t calibrationOnset{-1};
+    uint64_t calibrationReleasePos{0};
+    silence::SilenceDetector calibrationDetector;
+
+    void calibrationStart()
+    {
+        calibrateRequested = false;
+        createState = CALIBRATING;
+        calibrationPos = 0;
+        calibrationOnset = -1;
+        calibrationReleasePos = 0;
+        calibrationDetector.reset(silenceSettings);
+        pushStatus("Calibrate", 0);
+        pushStatus("Latency", 1);
+        pushMessage("Measuring latency through the patch");
+    }
+
+    void calibrationProcess(float sampleRate)
+    {
+        for (auto o : {OUTPUT_VOCT, OUTPUT_GATE, OUTPUT_VELOCITY, OUTPUT_RR_ONE, OUTPUT_RR_TWO})
+            outputs[o].setChannels(1);
+
+        auto ms = std::round(getParam(MIDI_START_RANGE).getValue());
+        auto me = std::round(getParam(MIDI_END_RANGE).getValue());
+        auto gateLen = (uint64_t)(sampleRate * calibrationGateSeconds);
+        auto timeout = (uint64_t)sampleRate;
+
+        bool gateOn = calibrationOnset < 0 ? calibrationPos < timeout : calibrationPos < gateLen;
+        gateOn = gateOn && !stopImmediately;
+        outputs[OUTPUT_VOCT].setVoltage(std::clamp((ms + me) / 24.f - 5.f, -5.f, 5.f));
+        outputs[OUTPUT_GATE].setVoltage(gateOn ? 10.f : 0.f);
+        outputs[OUTPUT_VELOCITY].setVoltage(10.f);
+
+        auto l = inputs[INPUT_L].getVoltage() / 5.f;
+        auto r = inputs[INPUT_R].getVoltage() / 5.f;
+
+        if (calibrationOnset < 0 && gateOn)
+        {
+            static const float thresh = std::pow(10.f, calibrationThresholdDb / 20.f);
+            if (std::max(std::fabs(l), std::fabs(r)) > thresh)
+            {
+                calibrationOnset = calibrationPos;
+                auto lat = std::clamp((int)calibrationOnset - calibrationMargin, 0, 512);
+                getParam(LATENCY_COMPENSATION).setValue(lat);
+                pushMessage("Measured onset at " + std::to_string(calibrationOnset) +
+                            " samples; latency compensation set to " + std::to_string(lat));
+            }
+        }
+
+        if (!gateOn)
+        {
+            if (calibrationReleasePos == 0 && calibrationOnset < 0 && !stopImmediately)
+                pushError("No signal from the patch within a second; latency unchanged");
+            calibrationReleasePos++;
+
+            // wait for the tail, but no more than a few seconds
+            auto silent = calibrationDetector.process(l, r);
+            if (silent || calibrationReleasePos > 5 * timeout || stopImmediately)
+            {
+                stopImmediately = false;
+                createState = INACTIVE;
+                pushIdle();
+            }
+        }
+        calibrationPos++;
+    }
+
+    /*
+     * Probes (see Probe.hpp) play their notes one at a time on the first channel. Each
+     * note is gated for the run's gate time and recorded until its tail is silent or the
+     * take is full, which also leaves the patch quiet for the next note. The render thread
+     * analyses the takes once the last one is done.
+     */
+    static constexpr float probeMaxGateSeconds{1.f}, probeMaxTailSeconds{2.f};
+    std::unique_ptr<probe::ProbeRun> probeRun;
+    std::atomic<bool> probeRequested{false}, probeAnalyzeRequested{false};
+    size_t probeTakeIndex{0};
+    uint64_t probePos{0};
+    silence::SilenceDetector probeDetector;
+
+    bool probeBusy() const
+    {
+        return probeRequested || probeAnalyzeRequested || createState == PROBING;
+    }
+
+    // On the UI thread; the run is ours until we set probeRequested
+    void requestProbe(std::unique_ptr<probe::ProbeRun> run)
+    {
+        if (probeBusy() || createState != INACTIVE || run->takes.empty())
+            return;
+        run->allocate(probeMaxTailSeconds);
+        probeRun = std::move(run);
+        probeRequested = true;
+    }
+
+    std::unique_ptr<probe::ProbeRun> makeProbeRun(probe::Kind k, const PlanParameters &pp)
+    {
+        auto res = std::make_unique<probe::ProbeRun>();
+        res->kind = k;
+        res->sampleRate = engineSampleRate;
+        res->gateSeconds = std::clamp(pp.gateTime, 0.05f, probeMaxGateSeconds);
+        return res;
+    }
+
+    void probeAddJobs(probe::ProbeRun &run, const JobTable &jobs)
+    {
+        for (auto j : jobs)
+        {
+            probe::ProbeNote n;
+            n.midiNote = j.midiNote;
+            n.velocity = j.velocity;
+            for (int d = 0; d < RenderJob::nRRVoltages; ++d)
+                n.rrRand[d] = j.rrRand[d];
+            run.add(n);
+        }
     }
 
-    void populateRenderJobs(std::vector<RenderJob> &onto)
-    {
-        onto.clear();
-        auto numVel = (int)std::round(getParam(NUM_VEL_LAYERS).getValue());
-        auto numRR = (int)std::round(getParam(NUM_ROUND_ROBINS).getValue());
-        auto midiStep = (int)std::round(getParam(MIDI_STEP_SIZE).getValue());
-        auto midiHalf = midiStep <= 2 ? 0 : midiStep / 2;
+    /*
+     * Does the patch respond to the RR voltages at all? Play the middle note of the range
+     * with the voltages of the first two round robins a render would use. If the takes
+     * match, every round robin would be a copy of the first, so we drop to one. Takes which
+     * never reach probeMinPeakDb tell us nothing, so the setting is left alone.
+     */
+    static constexpr float rrSameCorrelation{0.999f}, rrSameSpectrumDb{0.5f};
+    static constexpr float probeMinPeakDb{-60.f};
 
-        auto midiStart = (int)std::round(getParam(MIDI_START_RANGE).getValue());
-        auto midiEnd = (int)std::round(getParam(MIDI_END_RANGE).getValue());
+    void requestRoundRobinProbe()
+    {
+        auto pp = planParametersFromParams();
+        auto run = makeProbeRun(probe::ROUND_ROBIN, pp);
+        pp.numVel = 1;
+        pp.velocityLayers.clear();
+        pp.numRR = 2;
+        auto mid = (pp.midiStart + pp.midiEnd) / 2;
+        JobTable jobs;
+        populateNoteColumn(jobs, {mid, mid, mid}, pp);
+        probeAddJobs(*run, jobs);
+        requestProbe(std::move(run));
+    }
 
-        auto velStrategy = (int)std::round(getParam(VELOCITY_STRATEGY).getValue());
+    /*
+     * Adaptive key zones (see probe::placeByChange) replace the uniform midi step with up
+     * to adaptiveKeyMaxNotes sample notes, packed where the timbre changes quickly. The
+     * render thread publishes them and the plan builders read them with atomic_load.
+     */
+    static constexpr int keyProbeMaxNotes{25};
+    float adaptiveKeyMaxNotes{16};
+    using adaptivePoints_t = std::shared_ptr<const std::vector<int>>;
+    adaptivePoints_t adaptiveKeyNotes;
 
-        auto rrOneStrategy = (int)std::round(getParam(RR1_TYPE).getValue());
-        auto rrTwoStrategy = (int)std::round(getParam(RR2_TYPE).getValue());
+    void requestKeyZoneProbe()
+    {
+        auto pp = planParametersFromParams();
+        auto run = makeProbeRun(probe::KEY_ZONES, pp);
+        pp.numVel = 1;
+        pp.velocityLayers.clear();
+        pp.numRR = 1;
+        JobTable jobs;
+        for (auto n : probe::probeGrid(pp.midiStart, pp.midiEnd, keyProbeMaxNotes))
+            populateNoteColumn(jobs, {n, n, n}, pp);
+        probeAddJobs(*run, jobs);
+        requestProbe(std::move(run));
+    }
 
-        if (midiStart > midiEnd)
-            std::swap(midiStart, midiEnd);
+    void clearAdaptiveKeyNotes()
+    {
+        std::atomic_store(&adaptiveKeyNotes, adaptivePoints_t());
+    }
 
-        auto numSteps = (int)std::ceil(1.f * (midiEnd - midiStart + 1) / midiStep);
-        auto coverDiff = numSteps * midiStep - (midiEnd - midiStart);
+    /*
+     * Adaptive velocity layers. We play eight velocities on three notes across the range
+     * and measure each take's loudness (the loudest 50ms RMS) and brightness (its spectral
+     * centroid). The change between neighbouring velocities is the distance in units of
+     * velocityLoudnessUnitDb and velocityBrightnessUnitSemis, averaged over the notes which
+     * reached probeMinPeakDb at some velocity. A layer covers about velocityUnitsPerLayer of
+     * that, up to the NUM_VEL_LAYERS knob, and placeByChange puts the layers where the sound
+     * moves. A patch which ignores velocity ends up with one layer; one we never heard keeps
+     * whatever layers it had.
+     */
+    static constexpr int velocityProbeCount{8};
+    static constexpr float velocityLoudnessUnitDb{1.5f}, velocityBrightnessUnitSemis{1.f};
+    static constexpr float velocityUnitsPerLayer{3.f};
+    adaptivePoints_t adaptiveVelocityLayers;
 
-        onto.clear();
-        for (int i = 0; i < numSteps; ++i)
+    void requestVelocityLayerProbe()
+    {
+        auto pp = planParametersFromParams();
+        auto run = makeProbeRun(probe::VELOCITY_LAYERS, pp);
+        pp.numVel = 1;
+        pp.numRR = 1;
+        pp.velocityLayers.clear();
+        auto lo = std::min(pp.midiStart, pp.midiEnd), hi = std::max(pp.midiStart, pp.midiEnd);
+        std::set<int> notes{lo + (hi - lo) / 4, (lo + hi) / 2, hi - (hi - lo) / 4};
+        JobTable jobs;
+        for (auto n : notes)
         {
-            auto mn = i * midiStep + midiHalf + midiStart - coverDiff / 2;
-            auto nf = mn - midiHalf;
-            auto nt = nf + midiStep - 1;
+            JobTable col;
+            populateNoteColumn(col, {n, n, n}, pp);
+            auto j = col[0];
+            for (auto v : probe::probeGrid(16, 127, velocityProbeCount))
+            {
+                j.velocity = v;
+                jobs.push_back(j);
+            }
+        }
+        probeAddJobs(*run, jobs);
+        requestProbe(std::move(run));
+    }
 
-            nf = std::clamp(nf, midiStart, midiEnd);
-            nt = std::clamp(nt, midiStart, midiEnd);
-            mn = std::clamp((nf + nt) / 2, midiStart, midiEnd);
+    void clearAdaptiveVelocityLayers()
+    {
+        std::atomic_store(&adaptiveVelocityLayers, adaptivePoints_t());
+    }
 
-            auto dVel = 1.0 / (numVel);
+    void probeStart()
+    {
+        probeRequested = false;
+        createState = PROBING;
+        probeTakeIndex = 0;
+        probePos = 0;
+        probeDetector.reset(silenceSettings);
+        pushStatus("Probe", 0);
+        pushStatus(std::to_string(probeRun->takes.size()) + " notes", 1);
+        pushMessage("Probing the patch with " + std::to_string(probeRun->takes.size()) +
+                    " notes");
+    }
 
-            RenderJob mrj;
-            mrj.midiNote = mn;
-            mrj.noteFrom = nf;
-            mrj.noteTo = nt;
+    void probeProcess()
+    {
+        for (auto o : {OUTPUT_VOCT, OUTPUT_GATE, OUTPUT_VELOCITY, OUTPUT_RR_ONE, OUTPUT_RR_TWO})
+            outputs[o].setChannels(1);
+
+        auto &run = *probeRun;
+        auto &t = run.takes[probeTakeIndex];
+        auto gateLen = (uint64_t)(run.sampleRate * run.gateSeconds);
+        auto gateOn = probePos < gateLen && !stopImmediately;
+
+        outputs[OUTPUT_VOCT].setVoltage(std::clamp(t.note.midiNote / 12.f - 5.f, -5.f, 5.f));
+        outputs[OUTPUT_GATE].setVoltage(gateOn ? 10.f : 0.f);
+        outputs[OUTPUT_VELOCITY].setVoltage(std::clamp(t.note.velocity / 12.7f, 0.f, 10.f));
+        outputs[OUTPUT_RR_ONE].setVoltage(t.note.rrRand[0]);
+        outputs[OUTPUT_RR_TWO].setVoltage(t.note.rrRand[1]);
+
+        auto l = inputs[INPUT_L].getVoltage() / 5.f;
+        auto r = inputs[INPUT_R].isConnected() ? inputs[INPUT_R].getVoltage() / 5.f : l;
+        if (t.frames < t.L.size())
+        {
+            t.L[t.frames] = l;
+            t.R[t.frames] = r;
+            t.frames++;
+        }
+        probePos++;
 
-            for (int vl = 0; vl < numVel; ++vl)
-            {
-                auto bv = (vl + 0.5) * dVel;
-                auto sv = vl * dVel;
-                auto ev = (vl + 1) * dVel;
+        if (gateOn)
+            return;
+        if (!probeDetector.process(l, r) && t.frames < t.L.size() && !stopImmediately)
+            return;
 
-                std::function<double(double)> fn = [](double x) { return x; };
-                if (velStrategy == 1)
-                    fn = [](double x) { return sqrt(x); };
-                if (velStrategy == 2)
-                    fn = [](double x) { return x * x; };
+        probeTakeIndex++;
+        probePos = 0;
+        probeDetector.reset(silenceSettings);
+        if (probeTakeIndex < run.takes.size() && !stopImmediately)
+            return;
 
-                auto mv = (int)std::round(std::clamp(fn(bv), 0., 1.) * 128);
-                auto msv = (int)std::round(std::clamp(fn(sv), 0., 1.) * 128);
-                auto mev = (int)std::round(std::clamp(fn(ev), 0., 1.) * 128) - 1;
-                msv = std::clamp(msv, 1, 127);
-                mev = std::clamp(mev, 1, 127); // we can't use 0 since thats 'off'
-                mv = std::clamp(mv, msv, mev);
+        outputs[OUTPUT_GATE].setVoltage(0.f);
+        createState = INACTIVE;
+        if (stopImmediately)
+        {
+            pushMessage("Probe stopped");
+            stopImmediately = false;
+        }
+        else
+        {
+            probeAnalyzeRequested = true;
+        }
+        pushIdle();
+    }
 
-                auto vrj = mrj;
-                vrj.velocity = mv;
-                vrj.velFrom = msv;
-                vrj.velTo = mev;
+    // On the render thread
+    void renderThreadAnalyzeProbe()
+    {
+        auto &run = *probeRun;
+        switch (run.kind)
+        {
+        case probe::ROUND_ROBIN:
+        {
+            if (run.takes.size() < 2)
+                break;
+            const auto &a = run.takes[0];
+            const auto &b = run.takes[1];
+            auto pa = probe::peakDb(a), pb = probe::peakDb(b);
+            if (pa < probeMinPeakDb || pb < probeMinPeakDb)
+            {
+                pushMessage(rack::string::f("Round robin probe heard nothing (peaks %.1f and "
+                                            "%.1f dBFS); leaving them alone",
+                                            pa, pb));
+                break;
+            }
+            probe::SpectrumAnalyzer sa;
+            auto ncc = probe::normalizedCrossCorrelation(a, b, 64);
+            auto dist = probe::spectralDistanceDb(sa.bands(a, run.sampleRate),
+                                                  sa.bands(b, run.sampleRate));
+            auto stats = rack::string::f("correlation %.4f, spectra %.2f dB apart", ncc, dist);
+            if (ncc >= rrSameCorrelation && dist <= rrSameSpectrumDb)
+            {
+                getParam(NUM_ROUND_ROBINS).setValue(1);
+                pushMessage("Round robins sound the same (" + stats +
+                            "); set to one round robin");
+            }
+            else
+            {
+                pushMessage("Round robins differ (" + stats + "); leaving them alone");
+            }
+        }
+        break;
+        case probe::KEY_ZONES:
+        {
+            if (run.takes.size() < 2)
+                break;
+            probe::SpectrumAnalyzer sa;
+            std::vector<int> notes;
+            std::vector<std::vector<float>> envelopes;
+            for (const auto &t : run.takes)
+            {
+                // on a harmonic axis, so neighbouring probes differ by timbre, not pitch
+                auto f0 = 440.f * std::pow(2.f, (t.note.midiNote - 69) / 12.f);
+                notes.push_back(t.note.midiNote);
+                envelopes.push_back(
+                    probe::levelNormalized(sa.harmonicBands(t, run.sampleRate, f0)));
+            }
+            std::vector<float> change;
+            for (size_t i = 0; i + 1 < envelopes.size(); ++i)
+                change.push_back(probe::spectralDistanceDb(envelopes[i], envelopes[i + 1]));
+
+            auto placed = std::make_shared<const std::vector<int>>(
+                probe::placeByChange(notes, change, (int)adaptiveKeyMaxNotes));
+            std::string nl;
+            for (auto n : *placed)
+                nl += (nl.empty() ? "" : " ") + std::to_string(n);
+            std::atomic_store(&adaptiveKeyNotes, placed);
+            pushMessage("Adaptive key zones: " + std::to_string(placed->size()) +
+                        " notes (" + nl + "); the midi step is unused until they are cleared");
+        }
+        break;
+        case probe::VELOCITY_LAYERS:
+        {
+            // the takes come a note at a time, each with the same run of velocities
+            std::vector<int> vels;
+            for (const auto &t : run.takes)
+                if (t.note.midiNote == run.takes[0].note.midiNote)
+                    vels.push_back(t.note.velocity);
+            auto nv = vels.size();
+            if (nv < 2 || run.takes.size() % nv != 0)
+                break;
+
+            // a note the patch never sounded at any velocity tells us nothing
+            auto nNotes = run.takes.size() / nv;
+            std::vector<size_t> heard;
+            float loudest{-90.f};
+            for (size_t n = 0; n < nNotes; ++n)
+            {
+                float peak{-90.f};
+                for (size_t v = 0; v < nv; ++v)
+                    peak = std::max(peak, probe::peakDb(run.takes[n * nv + v]));
+                loudest = std::max(loudest, peak);
+                if (peak >= probeMinPeakDb)
+                    heard.push_back(n);
+            }
+            if (heard.empty())
+            {
+                pushMessage(rack::string::f("Velocity probe heard nothing (loudest peak %.1f "
+                                            "dBFS); leaving the layers alone",
+                                            loudest));
+                break;
+            }
 
-                for (int rr = 0; rr < numRR; ++rr)
+            probe::SpectrumAnalyzer sa;
+            auto window = (size_t)(run.sampleRate * 0.05f);
+            std::vector<float> change(nv - 1, 0.f);
+            for (auto n : heard)
+            {
+                float lastDb{0}, lastSemis{0};
+                for (size_t v = 0; v < nv; ++v)
                 {
-                    auto rj = vrj;
-                    rj.roundRobinIndex = rr;
-                    rj.roundRobinOutOf = numRR;
-                    switch (rrOneStrategy)
-                    {
-                    case 2: // index
-                        rj.rrRand[0] = (numRR == 1 ? 0 : 10.f * rr / (numRR - 1));
-                        break;
-                    case 1: // pm5v
-                        rj.rrRand[0] = uniReal(reng) * 10.f - 5.f;
-                        break;
-                    default:
-                    case 0: // 0-10v
-                        rj.rrRand[0] = uniReal(reng) * 10.f;
-                        break;
-                    }
-                    switch (rrTwoStrategy)
-                    {
-                    case 2: // index
-                        rj.rrRand[1] = (numRR == 1 ? 0 : 10.f * rr / (numRR - 1));
-                        break;
-                    case 1: // pm5v
-                        rj.rrRand[1] = uniReal(reng) * 10.f - 5.f;
-                        break;
-                    default:
-                    case 0: // 0-10v
-                        rj.rrRand[1] = uniReal(reng) * 10.f;
-                        break;
-                    }
-                    onto.push_back(rj);
+                    const auto &t = run.takes[n * nv + v];
+                    auto db = probe::peakRmsDb(t, window);
+                    sa.bands(t, run.sampleRate);
+                    auto semis = 12.f * std::log2(std::max(sa.centroidHz(run.sampleRate), 1.f));
+                    if (v > 0)
+                        change[v - 1] += std::hypot((db - lastDb) / velocityLoudnessUnitDb,
+                                                    (semis - lastSemis) /
+                                                        velocityBrightnessUnitSemis) /
+                                         heard.size();
+                    lastDb = db;
+                    lastSemis = semis;
                 }
             }
+
+            auto total = std::accumulate(change.begin(), change.end(), 0.f);
+            auto maxLayers = (int)std::round(getParam(NUM_VEL_LAYERS).getValue());
+            auto nLayers =
+                std::clamp((int)std::round(total / velocityUnitsPerLayer), 1, maxLayers);
+            auto placed = std::make_shared<const std::vector<int>>(
+                probe::placeByChange(vels, change, nLayers, 0.f));
+            std::string vl;
+            for (auto v : *placed)
+                vl += (vl.empty() ? "" : " ") + std::to_string(v);
+            std::atomic_store(&adaptiveVelocityLayers, placed);
+            pushMessage(rack::string::f("Velocity changes the sound by %.1f units; ", total) +
+                        std::to_string(placed->size()) + " adaptive layers (" + vl +
+                        "); the layer count and velocity strategy are unused until they are "
+                        "cleared");
+        }
+        break;
         }
     }
 
-    void process(const ProcessArgs &args) override
+    uint64_t spindownSamples() const
     {
-        if (createState == INACTIVE && startOperating)
-        {
-            pushStatus(testMode ? "Test" : "Record", 0);
-            pushStatus("Start", 1);
-            pushMessage(std::string("Starting render in ") +
-                        (testMode ? "Test Mode" : "Record Mode"));
-            startOperating = false;
-            createState = NEW_NOTE;
-            currentJobIndex = -1;
-            latencyInitValue = std::round(getParam(LATENCY_COMPENSATION).getValue());
-            gateInitValue = std::ceil(args.sampleRate * getParam(GATE_TIME).getValue());
-            releaseMode = (ReleaseMode)std::round(getParam(REL_MODE).getValue());
+        return spindownLength * (releaseMode == GATEONLY ? 16 : 1);
+    }
 
-            auto iv = (int)std::round(getParam(OUTPUT_FORMAT).getValue());
-            if (iv < JUST_WAV || iv > DECENT)
-                iv = JUST_WAV;
-            multiFormat = (MultiFormats)iv;
+    /*
+     * With adaptive settle we move on as soon as the input has been quiet for
+     * minSettleSamples rather than always waiting out the spindown. If it is still
+     * sounding when the spindown is up we keep waiting, up to settleExtension times as
+     * long, so a ringing patch doesn't bleed into the next take.
+     */
+    bool adaptiveSettle{true};
+    static constexpr uint64_t minSettleSamples{64};
+    static constexpr uint64_t settleExtension{4};
+    silence::SilenceDetector settleDetector;
 
-            if (currentSampleDir.empty())
-                currentSampleDir = fs::path{rack::asset::userDir} / "SampleCreator" / "Default";
-            currentSampleWavDir = currentSampleDir / "wav";
+    silence::SilenceDetector::Settings settleSettings() const
+    {
+        return {silence::SilenceDetector::PEAK, silenceSettings.thresholdDb, minSettleSamples};
+    }
 
-            if (multiFormat == MULTISAMPLE)
-            {
-                currentSampleWavDir = currentSampleDir / "raw";
-            }
+    bool settleDone(bool quiet, uint64_t elapsed) const
+    {
+        if (!adaptiveSettle)
+            return elapsed > spindownSamples();
+        if (quiet)
+            return true;
+        return elapsed > spindownSamples() * settleExtension;
+    }
 
-            if (!testMode)
+    int overlapLimit() const { return overlapLimit(nVoices); }
+    int overlapLimit(int voices) const
+    {
+        return maxOverlap == 0 ? voices : std::min(maxOverlap, voices);
+    }
+
+    /*
+     * Start the next job in the plan order which isn't on disk or another shard's, if there
+     * is one, on voice v. Returns false without moving on if the shared queue claim for it
+     * hasn't come back yet.
+     */
+    bool startNextJob(int v, float sampleRate)
+    {
+        const auto &renderJobs = audioPlan->jobs;
+        const auto &jobOrder = audioPlan->order;
+        while (nextJobIndex < (int64_t)jobOrder.size())
+        {
+            auto ji = jobOrder[nextJobIndex];
+            if (queueSharding && !jobSkipped[ji] && jobClaims[ji] == CLAIM_PENDING)
             {
-                try
-                {
-                    fs::create_directories(currentSampleDir);
-                    fs::create_directories(currentSampleWavDir);
-                    pushMessage("Output to '" + currentSampleDir.u8string() + "'");
-                }
-                catch (const fs::filesystem_error &e)
-                {
-                    pushError(std::string() + "Unable to create output directories : " + e.what());
-                }
+                jobsStarted = nextJobIndex;
+                return false;
             }
-
-            populateRenderJobs(renderJobs);
-            renderThreadCommands.push(RenderThreadCommand{RenderThreadCommand::START_RENDER});
-            pushMessage(std::string("Generated render jobs: " + std::to_string(renderJobs.size()) +
-                                    " renders"));
-            clearVU();
+            if (!jobSkipped[ji] && !(queueSharding && jobClaims[ji] == CLAIM_ELSEWHERE))
+                break;
+            nextJobIndex++;
         }
+        jobsStarted = nextJobIndex;
+        if (nextJobIndex >= (int64_t)jobOrder.size())
+            return startRetryJob(v, sampleRate);
+
+        auto ji = jobOrder[nextJobIndex];
+        nextJobIndex++;
+        voiceStart(v, ji, sampleRate);
+        pushStatus(std::to_string(nextJobIndex) + "/" + std::to_string(renderJobs.size()) + " " +
+                       midiNoteToName(renderJobs.midiNote[ji]),
+                   1);
+        return true;
+    }
 
-        if (createState == INACTIVE)
+    // Re-record the next take queued as overloaded, once the plan order is done
+    bool startRetryJob(int v, float sampleRate)
+    {
+        if (retryNext >= retryQueue.size())
+            return false;
+        auto ji = retryQueue[retryNext++];
+        voiceStart(v, ji, sampleRate);
+        pushStatus("Retry " + std::to_string(retryNext) + "/" + std::to_string(retryQueue.size()) +
+                       " " + midiNoteToName(audioPlan->jobs.midiNote[ji]),
+                   1);
+        return true;
+    }
+
+    bool jobsRemaining() const
+    {
+        return nextJobIndex < (int64_t)audioPlan->order.size() || retryNext < retryQueue.size();
+    }
+
+    void populateJobOrder(PlanSnapshot &plan)
+    {
+        const auto &renderJobs = plan.jobs;
+        auto &jobOrder = plan.order;
+        auto &jobPasses = plan.passes;
+        jobOrder.resize(renderJobs.size());
+        for (size_t i = 0; i < renderJobs.size(); ++i)
+            jobOrder[i] = i;
+        if (jobOrdering == COARSE_TO_FINE)
         {
-            outputs[OUTPUT_VOCT].setVoltage(0.f);
-            outputs[OUTPUT_GATE].setVoltage(0.f);
-            clearVU();
+            jobPasses = progressive::coarseToFinePasses(renderJobs);
+            std::stable_sort(jobOrder.begin(), jobOrder.end(), [&jobPasses](auto a, auto b) {
+                return jobPasses.pass[a] < jobPasses.pass[b];
+            });
             return;
         }
+        if (jobOrdering != PITCH_SPREAD || renderJobs.empty())
+            return;
 
-        if (createState == NEW_NOTE)
+        // One queue per note, visited in a strided order so neighbouring starts are
+        // roughly (notes / voices) apart, then take one job from each queue in turn.
+        std::map<int, std::deque<int64_t>> byNote;
+        for (size_t i = 0; i < renderJobs.size(); ++i)
+            byNote[renderJobs.midiNote[i]].push_back(i);
+
+        std::vector<std::deque<int64_t> *> queues;
+        for (auto &[n, q] : byNote)
+            queues.push_back(&q);
+        auto nq = (int)queues.size();
+        auto ol = overlapLimit(plan.nVoices);
+        auto stride = std::max(1, (nq + ol - 1) / ol);
+        std::vector<std::deque<int64_t> *> strided;
+        for (int off = 0; off < stride; ++off)
+            for (int k = off; k < nq; k += stride)
+                strided.push_back(queues[k]);
+
+        jobOrder.clear();
+        while (jobOrder.size() < renderJobs.size())
+        {
+            for (auto *q : strided)
+            {
+                if (q->empty())
+                    continue;
+                jobOrder.push_back(q->front());
+                q->pop_front();
+            }
+        }
+    }
+
+    void pushEndRender()
+    {
+        renderEnding = true;
+        renderThreadCommands.push(RenderThreadCommand{RenderThreadCommand::END_RENDER});
+    }
+
+    void endRender()
+    {
+        createState = INACTIVE;
+        pushEndRender();
+        currentJobIndex = -1;
+
+        clearVU();
+        pushIdle();
+    }
+
+    void voiceStart(int v, int64_t jobIndex, float sampleRate)
+    {
+        const auto &renderJobs = audioPlan->jobs;
+        auto &vc = voices[v];
+        vc.state = GATED_RECORD;
+        vc.jobIndex = jobIndex;
+        vc.playbackPos = 0;
+        vc.latencySamples = latencyInitValue;
+        vc.gateSamples = std::ceil(sampleRate * renderJobs.gateSeconds[jobIndex]);
+        vc.maxTailSamples = std::ceil(sampleRate * renderJobs.maxTailSeconds[jobIndex]);
+        vc.awaitingOnset = trimLeadingSilence;
+        vc.gateAdapted = false;
+        if (adaptiveGate)
         {
-            currentJobIndex++;
-            auto jbn = renderJobs[currentJobIndex].midiNote;
-            pushStatus(std::to_string(currentJobIndex) + "/" + std::to_string(renderJobs.size()) +
-                           " " + midiNoteToName(jbn),
-                       1);
-            playbackPos = 0;
-            createState = GATED_RECORD;
+            auto hz = 440.f * std::pow(2.f, (renderJobs.midiNote[jobIndex] - 69) / 12.f);
+            vc.steady.reset(hz, sampleRate);
+        }
+        vc.ioBlock = claimIOBlock();
+        vc.ioPosition = 0;
+        vc.timing.reset();
+
+        voiceJobIndex[v] = jobIndex;
+        currentJobIndex = jobIndex;
+
+        renderThreadCommands.push(RenderThreadCommand{RenderThreadCommand::NEW_NOTE, jobIndex,
+                                                      (int64_t)sampleRate, v});
+    }
+
+    int claimIOBlock()
+    {
+        auto res = ioNextBlock;
+        ioNextBlock = (ioNextBlock + 1) & (ioSampleBlocksAvailable - 1);
+        return res;
+    }
+
+    void voicePushFrame(int v, float l, float r)
+    {
+        auto &vc = voices[v];
+        auto &f2 = ioBlocks[vc.ioBlock][vc.ioPosition];
+        f2[0] = l;
+        f2[1] = r;
+
+        vc.ioPosition++;
+        if (vc.ioPosition == ioSampleBlockSize)
+            voicePushBlock(v);
+    }
+
+    /*
+     * Hand the voice's block to the writer and claim the next. Each voice holds a block
+     * while it fills, so once the blocks in flight leave fewer than maxVoices free, the
+     * ring can wrap onto one the writer hasn't reached.
+     */
+    void voicePushBlock(int v)
+    {
+        auto &vc = voices[v];
+        renderThreadCommands.push(
+            RenderThreadCommand{RenderThreadCommand::PUSH_SAMPLES, vc.ioBlock, vc.ioPosition, v});
+        auto inFlight = ++ioBlocksPushed - ioBlocksWritten;
+        if (inFlight + maxVoices >= (uint64_t)ioSampleBlocksAvailable)
+            vc.timing.overruns++;
+        vc.ioBlock = claimIOBlock();
+        vc.ioPosition = 0;
+    }
 
-            latencySamples = latencyInitValue;
-            gateSamples = gateInitValue;
+    /*
+     * Flush the partial block and close the take. tailFrames is the length after gate off;
+     * an aborted take (Stop) is removed rather than kept.
+     */
+    void voiceFinish(int v, uint64_t tailFrames, bool aborted = false)
+    {
+        auto &vc = voices[v];
+        if (vc.ioPosition > 0)
+            voicePushBlock(v);
+
+        double floor;
+        if (lagClock.partialFloor(floor))
+            vc.timing.windowDone(floor);
+        uint16_t flags = (vc.timing.overloaded() ? manifest::TAKE_ENGINE_OVERLOAD : 0) |
+                         (vc.timing.overruns ? manifest::TAKE_TRANSPORT_OVERRUN : 0);
+        auto ji = vc.jobIndex;
+        int attempt{0};
+        if (ji >= 0 && ji < (int64_t)retryCount.size())
+        {
+            attempt = retryCount[ji];
+            if (attempt > 0)
+                flags |= manifest::TAKE_RERECORDED;
+            if ((flags & suspectTakeFlags) && !testMode && !stopImmediately &&
+                attempt < overloadRetries && retryQueue.size() < retryQueue.capacity())
+            {
+                attempt = ++retryCount[ji];
+                retryQueue.push_back(ji);
+                flags |= manifest::TAKE_REQUEUED;
+            }
+        }
 
+        if (!testMode)
+        {
+            if (flags && !aborted)
+                renderThreadCommands.push(RenderThreadCommand{
+                    RenderThreadCommand::FLAG_TAKE, ji, flags | ((int64_t)attempt << 16), v});
             renderThreadCommands.push(RenderThreadCommand{
-                RenderThreadCommand::NEW_NOTE, currentJobIndex, (int64_t)args.sampleRate});
-            ioWriteBlock = (ioWriteBlock + 1) & (ioSampleBlocksAvailable - 1);
-            ioWritePosition = 0;
+                RenderThreadCommand::CLOSE_FILE, vc.jobIndex, (int64_t)tailFrames, v, aborted});
+        }
+        vc.state = INACTIVE;
+        vc.idleSamples = 0;
+        vc.settle.reset(settleSettings());
+        voiceJobIndex[v] = -1;
+    }
+
+    void voiceProcess(int v)
+    {
+        auto &vc = voices[v];
+        if (vc.state == INACTIVE)
+        {
+            outputs[OUTPUT_GATE].setVoltage(0.f, v);
+            return;
         }
 
-        auto &currentJob = renderJobs[currentJobIndex];
+        const auto &renderJobs = audioPlan->jobs;
+        auto ji = vc.jobIndex;
+        const auto *rrv = &renderJobs.rrRand[ji * RenderJob::nRRVoltages];
         outputs[OUTPUT_VOCT].setVoltage(
-            std::clamp((float)currentJob.midiNote / 12.f - 5.f, -5.f, 5.f));
-        outputs[OUTPUT_GATE].setVoltage((createState == GATED_RECORD) * 10.f);
+            std::clamp((float)renderJobs.midiNote[ji] / 12.f - 5.f, -5.f, 5.f), v);
+        outputs[OUTPUT_GATE].setVoltage((vc.state == GATED_RECORD) * 10.f, v);
         outputs[OUTPUT_VELOCITY].setVoltage(
-            std::clamp((float)currentJob.velocity / 12.7f, 0.f, 10.f));
-        outputs[OUTPUT_RR_ONE].setVoltage(currentJob.rrRand[0]);
-        outputs[OUTPUT_RR_TWO].setVoltage(currentJob.rrRand[1]);
+            std::clamp((float)renderJobs.velocity[ji] / 12.7f, 0.f, 10.f), v);
+        outputs[OUTPUT_RR_ONE].setVoltage(rrv[0], v);
+        outputs[OUTPUT_RR_TWO].setVoltage(rrv[1], v);
 
-        if (stopImmediately)
+        // A mono input to a polyphonic render would record the same voice everywhere
+        if (nVoices > 1 && !warnedInputChannels && vc.playbackPos == latencyInitValue + 64 &&
+            inputs[INPUT_L].getChannels() < nVoices)
         {
-            pushMessage("Stopping operation");
-            clearVU();
+            warnedInputChannels = true;
+            pushError("Input has " + std::to_string(inputs[INPUT_L].getChannels()) +
+                      " channels but polyphony is " + std::to_string(nVoices));
+        }
 
-            if (!testMode)
-            {
-                renderThreadCommands.push(
-                    RenderThreadCommand{RenderThreadCommand::CLOSE_FILE, currentJobIndex});
-            }
-            createState = INACTIVE;
-            currentJobIndex = -1;
-            clearVU();
-            pushIdle();
-            stopImmediately = false;
-            return;
+        float d[2];
+        d[0] = inputs[INPUT_L].getPolyVoltage(v) / 5.f;
+        d[1] = inputs[INPUT_R].getPolyVoltage(v) / 5.f;
+
+        if (adaptiveGate && vc.state == GATED_RECORD && !vc.gateAdapted && vc.latencySamples == 0 &&
+            vc.steady.process(d[0], d[1]) && vc.playbackPos >= adaptiveGateMinSamples)
+        {
+            vc.gateAdapted = true;
+            vc.gateSamples = std::min(vc.gateSamples, vc.playbackPos + adaptiveGateHoldSamples);
         }
 
-        if (playbackPos > gateSamples && createState == GATED_RECORD)
+        if (vc.playbackPos > vc.gateSamples && vc.state == GATED_RECORD)
         {
+            vc.awaitingOnset = false;
             if (releaseMode == SILENCE)
             {
-                createState = RELEASE_RECORD;
-                memset(&silenceDetector[0], 0, sizeof(silenceDetector));
-                silencePosition = 0;
+                vc.state = RELEASE_RECORD;
+                vc.detector.reset(silenceSettings);
             }
             else if (releaseMode == GATEONLY)
             {
-                createState = GATE_RELEASE_FADE;
+                vc.state = GATE_RELEASE_FADE;
             }
             else
             {
                 pushError("Unhandled loop mode");
-                createState = SPINDOWN_BUFFER;
+                voiceFinish(v, 0);
+                return;
             }
 
-            playbackPos = 0;
-        }
-
-        if (createState == RELEASE_RECORD)
-        {
-            float d[2];
-            d[0] = inputs[INPUT_L].getVoltage() / 5.f;
-            d[1] = inputs[INPUT_R].getVoltage() / 5.f;
-
-            silenceDetector[silencePosition] = std::fabs(d[0]) + std::fabs(d[1]);
-            silencePosition++;
-            if (silencePosition == silenceSamples)
-            {
-                silencePosition = 0;
-
-                bool silent{true};
-                int32_t spos{0};
-
-                while (silent && spos < silenceSamples)
-                {
-                    silent = silenceDetector[spos] < 1e-6;
-                    spos++;
-                }
-
-                if (silent)
-                {
-                    createState = SPINDOWN_BUFFER;
-                    playbackPos = 0;
-                    if (!testMode)
-                    {
-                        renderThreadCommands.push(
-                            RenderThreadCommand{RenderThreadCommand::CLOSE_FILE, currentJobIndex});
-                    }
-                    clearVU();
-                }
-            }
+            vc.playbackPos = 0;
         }
 
-        if (createState == GATE_RELEASE_FADE)
+        if (vc.state == RELEASE_RECORD)
         {
-            float f2[2];
-            f2[0] = inputs[INPUT_L].getVoltage() / 5.f;
-            f2[1] = inputs[INPUT_R].getVoltage() / 5.f;
-
-            auto dist = 1.0 - 1.0 * playbackPos / gateOnlyFadeLength;
-            f2[0] *= dist;
-            f2[1] *= dist;
-
-            if (!testMode)
-            {
-                renderThreadCommands.push(RenderThreadCommand{
-                    RenderThreadCommand::PUSH_SINGLE_SAMPLE, 0, 0, f2[0], f2[1]});
-            }
-
-            if (playbackPos == gateOnlyFadeLength)
+            if (vc.detector.process(d[0], d[1]))
             {
-                if (!testMode)
-                {
-                    renderThreadCommands.push(
-                        RenderThreadCommand{RenderThreadCommand::CLOSE_FILE, currentJobIndex});
-                }
-                playbackPos = 0;
-                createState = SPINDOWN_BUFFER;
+                voiceFinish(v, vc.playbackPos);
+                return;
             }
-        }
-        else if (createState != SPINDOWN_BUFFER)
-        {
-            if (latencySamples == 0)
+            if (vc.maxTailSamples > 0 && vc.playbackPos >= vc.maxTailSamples)
             {
-                auto &f2 = ioBlocks[ioWriteBlock][ioWritePosition];
-                f2[0] = inputs[INPUT_L].getVoltage() / 5.f;
-                f2[1] = inputs[INPUT_R].getVoltage() / 5.f;
-
-                ioWritePosition = (ioWritePosition + 1) & (ioSampleBlockSize - 1);
-                // Insanely inefficient. We need to block this into a better chunk and send a chunk
-                // index And when we do that we can shrink the queue again
-                if (ioWritePosition == 0)
-                {
-                    renderThreadCommands.push(
-                        RenderThreadCommand{RenderThreadCommand::PUSH_SAMPLES, ioWriteBlock});
-                    ioWriteBlock = (ioWriteBlock + 1) & (ioSampleBlocksAvailable - 1);
-                }
+                const auto &job = renderJobs[vc.jobIndex];
+                pushMessage("Tail of " + midiNoteToName(job.midiNote) +
+                            " never went silent; stopped at " +
+                            rack::string::f("%.2f", job.maxTailSeconds) + "s");
+                voiceFinish(v, vc.playbackPos);
+                return;
             }
-            if (latencySamples > 0)
-                latencySamples--;
         }
 
-        if (playbackPos > spindownLength * (releaseMode == GATEONLY ? 16 : 1) &&
-            createState == SPINDOWN_BUFFER)
+        if (vc.state == GATE_RELEASE_FADE)
         {
-            if ((size_t)currentJobIndex == renderJobs.size() - 1)
-            {
-                createState = INACTIVE;
-                renderThreadCommands.push(RenderThreadCommand{RenderThreadCommand::END_RENDER});
-                currentJobIndex = -1;
+            auto dist = 1.0 - 1.0 * vc.playbackPos / gateOnlyFadeLength;
+            voicePushFrame(v, d[0] * dist, d[1] * dist);
 
-                clearVU();
-                pushIdle();
-            }
-            else
+            if (vc.playbackPos == gateOnlyFadeLength)
             {
-                createState = NEW_NOTE;
+                voiceFinish(v, vc.playbackPos);
+                return;
             }
         }
+        else
+        {
+            if (vc.latencySamples == 0 && vc.awaitingOnset)
+                vc.awaitingOnset = std::max(std::fabs(d[0]), std::fabs(d[1])) < onsetThreshold;
+            if (vc.latencySamples == 0 && !vc.awaitingOnset)
+                voicePushFrame(v, d[0], d[1]);
+            if (vc.latencySamples > 0)
+                vc.latencySamples--;
+        }
 
-        playbackPos++;
+        vc.playbackPos++;
     }
 
     void clearVU()
@@ -1016,13 +3377,13 @@ struct SampleCreatorModule : virtual rack::Module,
         vuLevels[1] = 0.f;
     }
 
-    void updateVU(int64_t whichBlock)
+    void updateVU(int64_t whichBlock, int nFrames)
     {
         auto &data = ioBlocks[whichBlock];
         float vul[2];
         vul[0] = vuLevels[0] * 0.9995;
         vul[1] = vuLevels[1] * 0.9995;
-        for (int i = 0; i < ioSampleBlockSize; ++i)
+        for (int i = 0; i < nFrames; ++i)
         {
             auto fl = fabs(data[i][0]);
             if (fl > vul[0])
@@ -0,0 +1,145 @@
+/*
+ * SampleCreator
+ *
+ * An experimental idea based on a preliminary convo. Probably best to come back later.
+ *
+ * Copyright Paul Walker 2024
+ *
+ * Released under the MIT License. See `LICENSE.md` for details
+ */
+
+/*
+ * A headless version of the module's "Rewrap Existing Samples". Point it at an output
+ * directory from an earlier render and it rebuilds the multi-files from the wav files,
+ * writing each requested format on its own thread.
+ *
+ *   sample-creator-rewrap <sample-dir> sfz|decent|multisample|sf2|sf2-16 ...
+ */
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "RenderJob.hpp"
+#include "MultiFileWriter.hpp"
+#include "SF2Writer.hpp"
+#include "ZIPFileWriter.hpp"
+#include "Rewrap.hpp"
+
+namespace sc = baconpaul::samplecreator;
+
+int main(int argc, char **argv)
+{
+    if (argc < 3)
+    {
+        std::cerr << "Usage: " << argv[0] << " <sample-dir> <format>...\n"
+                  << "   formats are sfz, decent, multisample, sf2 (24 bit) and sf2-16"
+                  << std::endl;
+        return 1;
+    }
+
+    // Each format writes its own file, so check them all before any thread starts; the
+    // same format twice (or both SF2 depths) would have two threads writing one file.
+    std::vector<std::string> formats;
+    for (int i = 2; i < argc; ++i)
+    {
+        auto fmt = std::string(argv[i]);
+        if (fmt != "sfz" && fmt != "decent" && fmt != "multisample" && fmt != "sf2" &&
+            fmt != "sf2-16")
+        {
+            std::cerr << "Unknown format '" << fmt << "'" << std::endl;
+            return 1;
+        }
+        if (std::find(formats.begin(), formats.end(), fmt) == formats.end())
+            formats.push_back(fmt);
+    }
+    if (std::count(formats.begin(), formats.end(), "sf2") &&
+        std::count(formats.begin(), formats.end(), "sf2-16"))
+    {
+        std::cerr << "sf2 and sf2-16 both write the same .sf2; choose one" << std::endl;
+        return 1;
+    }
+
+    auto sampleDir = fs::path{argv[1]};
+    auto wavDir = sampleDir / "wav";
+    if (!fs::is_directory(wavDir))
+        wavDir = sampleDir / "raw";
+    if (!fs::is_directory(wavDir))
+    {
+        std::cerr << "No wav or raw directory in '" << sampleDir.u8string() << "'" << std::endl;
+        return 1;
+    }
+
+    auto st = std::chrono::steady_clock::now();
+    std::vector<std::string> errors;
+    size_t listed{0};
+    auto takes = sc::rewrap::findTakes(sampleDir, wavDir, errors, listed);
+    for (const auto &e : errors)
+        std::cerr << e << "\n";
+    std::cout << "Found " << takes.size() << " samples in '" << wavDir.u8string() << "' ("
+              << listed << " from the manifests)" << std::endl;
+    if (takes.empty())
+        return 1;
+
+    auto name = sampleDir.filename().replace_extension().u8string();
+    auto base = sampleDir / name;
+    auto prefix = wavDir.filename().u8string() + "/";
+
+    std::mutex outMutex;
+    bool allOK{true};
+    auto report = [&](bool ok, const std::string &what, const std::string &err) {
+        std::lock_guard<std::mutex> g(outMutex);
+        if (ok)
+            std::cout << "Wrote " << what << std::endl;
+        else
+            std::cerr << "Failed writing " << what << " " << err << std::endl;
+        allOK = allOK && ok;
+    };
+
+    std::vector<std::thread> workers;
+    for (const auto &fmt : formats)
+    {
+        if (fmt == "sfz")
+        {
+            workers.emplace_back([&, fn = fs::path(base).replace_extension("sfz")]() {
+                report(sc::multifile::writeSFZ(fn, prefix, takes), fn.u8string(), "");
+            });
+        }
+        else if (fmt == "decent")
+        {
+            workers.emplace_back([&, fn = fs::path(base).replace_extension("dspreset")]() {
+                report(sc::multifile::writeDecent(fn, prefix, takes), fn.u8string(), "");
+            });
+        }
+        else if (fmt == "multisample")
+        {
+            workers.emplace_back([&]() {
+                auto fn = wavDir / "multisample.xml";
+                auto zf = fs::path(base).replace_extension(".multisample");
+                auto ok = sc::multifile::writeMultiSample(fn, name, takes) &&
+                          sc::ziparchive::zipDirToOutputFrom(zf, wavDir);
+                report(ok, zf.u8string(), "");
+            });
+        }
+        else
+        {
+            workers.emplace_back([&, tfb = (fmt == "sf2")]() {
+                auto fn = fs::path(base).replace_extension("sf2");
+                sc::sf2::SF2Writer w(fn, tfb);
+                auto ok = w.write(name, wavDir, takes);
+                report(ok, fn.u8string(), w.errMsg);
+            });
+        }
+    }
+    for (auto &w : workers)
+        w.join();
+
+    auto el = std::chrono::duration<double>(std::chrono::steady_clock::now() - st).count();
+    std::cout << "Rewrap complete in " << el << "s" << std::endl;
+    return allOK ? 0 : 1;
+}
@@ -0,0 +1,97 @@
+/*
+ * SampleCreator
+ *
+ * An experimental idea based on a preliminary convo. Probably best to come back later.
+ *
+ * Copyright Paul Walker 2024
+ *
+ * Released under the MIT License. See `LICENSE.md` for details
+ */
+
+#ifndef SRC_SILENCEDETECTOR_HPP
+#define SRC_SILENCEDETECTOR_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+namespace baconpaul::samplecreator::silence
+{
+/*
+ * Decides when a release tail has gone silent. The signal is "quiet" while its level
+ * (the peak of the two channels, or the RMS over a short sliding window) is below a dBFS
+ * threshold, and silent once it has been quiet for the hold time.
+ *
+ * Both measures are O(1) per frame: the peak just counts frames since the last loud one,
+ * and the RMS keeps a running sum over a ring. So we react on the frame the hold expires
+ * rather than at the end of a fixed stride.
+ */
+struct SilenceDetector
+{
+    enum Mode
+    {
+        PEAK,
+        RMS
+    };
+
+    struct Settings
+    {
+        Mode mode{PEAK};
+        float thresholdDb{-120.f};
+        uint32_t holdSamples{4096};
+    };
+
+    static constexpr uint32_t rmsWindow{1024}; // must be a power of two
+
+    Mode mode{PEAK};
+    float threshold{1e-6f}; // linear for PEAK, squared for RMS
+    uint32_t holdSamples{4096};
+
+    uint32_t quietFor{0};
+    float ring[rmsWindow]{};
+    uint32_t ringPos{0};
+    double sumSquares{0};
+
+    void reset(const Settings &s)
+    {
+        mode = s.mode;
+        auto lin = std::pow(10.f, s.thresholdDb / 20.f);
+        threshold = mode == RMS ? lin * lin : lin;
+        holdSamples = std::max(s.holdSamples, 1U);
+        quietFor = 0;
+        ringPos = 0;
+        sumSquares = 0;
+        memset(ring, 0, sizeof(ring));
+    }
+
+    // returns true once the signal has been below the threshold for the hold time
+    bool process(float l, float r)
+    {
+        bool quiet;
+        if (mode == RMS)
+        {
+            auto sq = 0.5f * (l * l + r * r);
+            sumSquares += sq - ring[ringPos];
+            ring[ringPos] = sq;
+            ringPos = (ringPos + 1) & (rmsWindow - 1);
+            if (ringPos == 0)
+            {
+                // stop the running sum drifting
+                sumSquares = 0;
+                for (auto f : ring)
+                    sumSquares += f;
+            }
+            quiet = sumSquares < threshold * rmsWindow;
+        }
+        else
+        {
+            quiet = std::max(std::fabs(l), std::fabs(r)) < threshold;
+        }
+
+        quietFor = quiet ? quietFor + 1 : 0;
+        return quietFor >= holdSamples;
+    }
+};
+} // namespace baconpaul::samplecreator::silence
+#endif // SAMPLECREATOR_SILENCEDETECTOR_HPP
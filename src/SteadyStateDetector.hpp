@@ -0,0 +1,129 @@
+/*
+ * SampleCreator
+ *
+ * An experimental idea based on a preliminary convo. Probably best to come back later.
+ *
+ * Copyright Paul Walker 2024
+ *
+ * Released under the MIT License. See `LICENSE.md` for details
+ */
+
+#ifndef SRC_STEADYSTATEDETECTOR_HPP
+#define SRC_STEADYSTATEDETECTOR_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+namespace baconpaul::samplecreator::steadystate
+{
+/*
+ * Decides when a held note has stopped evolving. Every block we measure the level and,
+ * with a Goertzel filter per harmonic of the note, the magnitude of the first few
+ * harmonics. The note is steady once, for steadyBlocks blocks in a row, the level has moved
+ * less than levelToleranceDb and the spectral flux over those harmonics (the summed change
+ * in magnitude relative to the total) is below fluxTolerance, both measured against the
+ * first block of the run.
+ *
+ * Following the harmonics rather than a full FFT keeps this to a handful of multiply adds
+ * per frame per voice, and a note which has decayed to nothing counts as steady too.
+ */
+struct SteadyStateDetector
+{
+    static constexpr int nHarmonics{8};
+    static constexpr int blockSize{1024};
+
+    float levelToleranceDb{0.5f};
+    float fluxTolerance{0.05f};
+    int steadyBlocks{16}; // about a third of a second at 48k
+
+    int nActive{0};
+    float coeff[nHarmonics]{};
+    float s1[nHarmonics]{}, s2[nHarmonics]{};
+    float refMag[nHarmonics]{};
+    double sumSquares{0};
+    float refLevelDb{0};
+    bool hasReference{false};
+    int blockPos{0};
+    int steadyCount{0};
+
+    // Hann windowed, so a harmonic between bins doesn't flicker with its phase each block
+    float window[blockSize];
+    SteadyStateDetector()
+    {
+        for (int i = 0; i < blockSize; ++i)
+            window[i] = 0.5f - 0.5f * std::cos(2.f * (float)M_PI * i / (blockSize - 1));
+    }
+
+    void reset(float fundamentalHz, float sampleRate)
+    {
+        nActive = 0;
+        for (int h = 0; h < nHarmonics; ++h)
+        {
+            auto f = fundamentalHz * (h + 1);
+            if (f > sampleRate * 0.45f)
+                break;
+            coeff[h] = 2.f * std::cos(2.f * (float)M_PI * f / sampleRate);
+            nActive++;
+        }
+        std::fill(s1, s1 + nHarmonics, 0.f);
+        std::fill(s2, s2 + nHarmonics, 0.f);
+        sumSquares = 0;
+        hasReference = false;
+        blockPos = 0;
+        steadyCount = 0;
+    }
+
+    // returns true while the note has been steady for at least steadyBlocks blocks
+    bool process(float l, float r)
+    {
+        auto x = 0.5f * (l + r) * window[blockPos];
+        sumSquares += 0.5f * (l * l + r * r);
+        for (int h = 0; h < nActive; ++h)
+        {
+            auto s0 = x + coeff[h] * s1[h] - s2[h];
+            s2[h] = s1[h];
+            s1[h] = s0;
+        }
+
+        if (++blockPos < blockSize)
+            return steadyCount >= steadyBlocks;
+
+        float mag[nHarmonics]{};
+        float total{0}, flux{0};
+        for (int h = 0; h < nActive; ++h)
+        {
+            auto m2 = s1[h] * s1[h] + s2[h] * s2[h] - coeff[h] * s1[h] * s2[h];
+            mag[h] = std::sqrt(std::max(m2, 0.f));
+            total += mag[h];
+            flux += std::fabs(mag[h] - refMag[h]);
+            s1[h] = 0;
+            s2[h] = 0;
+        }
+        auto levelDb = 10.f * std::log10((float)(sumSquares / blockSize) + 1e-20f);
+        sumSquares = 0;
+        blockPos = 0;
+
+        /*
+         * Compare against the block which started the current steady run rather than the
+         * previous block, so a slow decay or filter sweep accumulates and breaks the run.
+         */
+        auto steady = hasReference && std::fabs(levelDb - refLevelDb) < levelToleranceDb &&
+                      (total <= 1e-12f || flux / total < fluxTolerance);
+        if (steady)
+        {
+            steadyCount++;
+        }
+        else
+        {
+            steadyCount = 0;
+            refLevelDb = levelDb;
+            std::copy(mag, mag + nHarmonics, refMag);
+            hasReference = true;
+        }
+
+        return steadyCount >= steadyBlocks;
+    }
+};
+} // namespace baconpaul::samplecreator::steadystate
+#endif // SAMPLECREATOR_STEADYSTATEDETECTOR_HPP
@@ -16,7 +16,7 @@
 
 namespace baconpaul::samplecreator::ziparchive
 {
-// Non-recursively travers indir to outdir
+// Recursively traverse indir to outdir, storing paths relative to indir
 inline bool zipDirToOutputFrom(const fs::path &outFile, const fs::path &inDir)
 {
     struct archive *a;
@@ -32,9 +32,10 @@ inline bool zipDirToOutputFrom(const fs::path &outFile, const fs::path &inDir)
     try
     {
         assert(fs::is_directory(inDir));
-        for (const auto &fsentry : fs::directory_iterator(inDir))
+        for (const auto &fsentry : fs::recursive_directory_iterator(inDir))
         {
-            assert(fs::is_regular_file(fsentry.path()));
+            if (!fs::is_regular_file(fsentry.path()))
+                continue;
             auto fs = fs::file_size(fsentry.path());
 
             fp = fopen(fsentry.path().u8string().c_str(), "rb");
@@ -44,7 +45,8 @@ inline bool zipDirToOutputFrom(const fs::path &outFile, const fs::path &inDir)
             }
 
             entry = archive_entry_new(); // Note 2
-            archive_entry_set_pathname(entry, fsentry.path().filename().u8string().c_str());
+            auto rel = fsentry.path().lexically_relative(inDir).generic_u8string();
+            archive_entry_set_pathname(entry, rel.c_str());
             archive_entry_set_size(entry, fs); // Note 3
             archive_entry_set_filetype(entry, AE_IFREG);
             archive_entry_set_perm(entry, 0644);